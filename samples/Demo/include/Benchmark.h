@@ -0,0 +1,7 @@
+#pragma once
+
+#include <ostream>
+
+//! Times the lookups of vars by name, the parsing of var files and the reads of var values against
+//! the structures they replace, and prints the results to \a out. Takes a few seconds.
+void runBenchmarks( std::ostream& out );
@@ -0,0 +1,196 @@
+#include "Benchmark.h"
+
+#include "cinder/JsonTree.h"
+
+#include "Var.h"
+#include "VarDocument.h"
+#include "VarRegistry.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+
+using namespace ci;
+
+namespace
+{
+	typedef std::map<std::string, std::map<std::string, VarBase*>> VarMap;
+
+	// keeps the optimizer from dropping the timed loops
+	volatile uintptr_t sSink;
+
+	template<typename Fn>
+	double nanosecondsPer(size_t count, Fn fn)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		fn();
+		const auto elapsed = std::chrono::steady_clock::now() - start;
+		return std::chrono::duration<double, std::nano>(elapsed).count() / count;
+	}
+
+	// the fence makes each iteration read the value again, as a frame would
+	template<typename Read>
+	double nanosecondsPerRead(size_t count, Read read)
+	{
+		return nanosecondsPer(count, [&] {
+			float sum = 0.0f;
+			for(size_t i = 0; i < count; ++i)
+			{
+				std::atomic_signal_fence(std::memory_order_seq_cst);
+				sum += read();
+			}
+			sSink = static_cast<uintptr_t>(sum);
+		});
+	}
+
+	// findVar() before the registry: split the full name, then search both maps
+	VarBase* findInMap(const VarMap& items, const std::string& fullName)
+	{
+		const auto index = fullName.find(VarRegistry::SEPARATOR);
+		if(index == std::string::npos)
+		{
+			return nullptr;
+		}
+		const auto groupIt = items.find(fullName.substr(0, index));
+		if(groupIt == items.end())
+		{
+			return nullptr;
+		}
+		const auto varIt = groupIt->second.find(fullName.substr(index + 1));
+		return varIt == groupIt->second.end() ? nullptr : varIt->second;
+	}
+
+	void benchmarkLookups(std::ostream& out, VarBase* var)
+	{
+		out << "look up a \"group.name\" var, ns per lookup" << std::endl;
+		for(size_t count = 1000; count <= 1000000; count *= 10)
+		{
+			// 100 vars per group, all pointing to the same var
+			std::vector<std::string> fullNames;
+			fullNames.reserve(count);
+			VarMap items;
+			VarRegistry registry;
+			for(size_t i = 0; i < count; ++i)
+			{
+				const std::string groupName = "group" + std::to_string(i / 100), name = "var" + std::to_string(i);
+				items[groupName][name] = var;
+				registry.insert(groupName, name, var);
+				fullNames.push_back(groupName + VarRegistry::SEPARATOR + name);
+			}
+			std::shuffle(fullNames.begin(), fullNames.end(), std::mt19937{ 1 });
+
+			const double mapTime = nanosecondsPer(count, [&] {
+				uintptr_t sum = 0;
+				for(const auto& fullName : fullNames)
+					sum += reinterpret_cast<uintptr_t>(findInMap(items, fullName));
+				sSink = sum;
+			});
+			// as JsonBag::findVar() does, under the items mutex
+			std::mutex mutex;
+			const double registryTime = nanosecondsPer(count, [&] {
+				uintptr_t sum = 0;
+				for(const auto& fullName : fullNames)
+				{
+					std::lock_guard<std::mutex> lock(mutex);
+					sum += reinterpret_cast<uintptr_t>(registry.find(fullName));
+				}
+				sSink = sum;
+			});
+			out << "  " << count << " vars: maps " << mapTime << ", locked registry " << registryTime << std::endl;
+		}
+	}
+
+	void benchmarkDocuments(std::ostream& out)
+	{
+		const size_t groupCount = 100, varCount = 100;
+		std::string text = "{\n";
+		for(size_t g = 0; g < groupCount; ++g)
+		{
+			text += "\t\"group" + std::to_string(g) + "\" : {\n";
+			for(size_t v = 0; v < varCount; ++v)
+			{
+				const std::string name = "\t\t\"var" + std::to_string(v) + "\" : ";
+				if(v % 2)
+					text += name + "{ \"x\" : \"" + std::to_string(v) + ".5\", \"y\" : \"" + std::to_string(g) + ".25\" },\n";
+				else
+					text += name + "\"" + std::to_string(v * 0.125) + "\",\n";
+			}
+			text += "\t\t\"last\" : \"0\"\n\t},\n";
+		}
+		text += "\t\"version\" : \"1\"\n}\n";
+
+		const fs::path path = fs::temp_directory_path() / "cinder_var_benchmark.json";
+		std::ofstream(path, std::ios::binary) << text;
+
+		// as load() read the files before VarDocument: a tree, then a copy of each group and value
+		const size_t runs = 10;
+		const double treeTime = nanosecondsPer(runs, [&] {
+			for(size_t run = 0; run < runs; ++run)
+			{
+				JsonTree doc(loadFile(path));
+				size_t size = 0;
+				for(size_t g = 0; g < groupCount; ++g)
+				{
+					const auto groupJson = doc.getChild("group" + std::to_string(g));
+					for(size_t v = 0; v < varCount; ++v)
+					{
+						const auto tree = groupJson.getChild("var" + std::to_string(v));
+						size += tree.hasChildren() ? tree.getNumChildren() : tree.getValue().size();
+					}
+				}
+				sSink = size;
+			}
+		});
+		const double documentTime = nanosecondsPer(runs, [&] {
+			for(size_t run = 0; run < runs; ++run)
+			{
+				const auto doc = VarDocument::load(path);
+				size_t size = 0;
+				for(size_t g = 0; g < groupCount; ++g)
+				{
+					const std::string groupName = "group" + std::to_string(g);
+					for(size_t v = 0; v < varCount; ++v)
+					{
+						const auto value = doc->find(groupName, "var" + std::to_string(v));
+						size += value->isObject ? value->fieldCount : value->text.size();
+					}
+				}
+				sSink = size;
+			}
+		});
+		fs::remove(path);
+
+		out << "load and look up " << groupCount * varCount << " values (" << text.size() / 1024 << " KiB), ms per file" << std::endl;
+		out << "  JsonTree " << treeTime / 1e6 << ", VarDocument " << documentTime / 1e6 << std::endl;
+	}
+
+	void benchmarkReads(std::ostream& out)
+	{
+		const size_t count = 100000000;
+		float plain = 1.0f;
+		sSink = reinterpret_cast<uintptr_t>(&plain);
+		Var<float> var{ 1.0f, "value", "benchmark" };
+		ArenaVar<float> arenaVar{ 1.0f, "arenaValue", "benchmark" };
+
+		const double plainTime = nanosecondsPerRead(count, [&] { return plain; });
+		const double varTime = nanosecondsPerRead(count, [&] { return var(); });
+		const double arenaTime = nanosecondsPerRead(count, [&] { return arenaVar(); });
+
+		out << "read a Var<float>, ns per read" << std::endl;
+		out << "  float " << plainTime << ", Var " << varTime << ", ArenaVar " << arenaTime << std::endl;
+	}
+}
+
+void runBenchmarks(std::ostream& out)
+{
+	Var<float> var{ 0.0f, "var", "benchmark" };
+
+	benchmarkLookups(out, &var);
+	benchmarkDocuments(out);
+	benchmarkReads(out);
+}
@@ -8,6 +8,8 @@
 #include "Watchdog.h"
 #include "Var.h"
 
+#include "Benchmark.h"
+
 using namespace ci;
 using namespace ci::app;
 
@@ -46,12 +48,14 @@ DemoApp::DemoApp()
 , mSpringK( 0.0025f, "springk" )
 {
 	wd::watch( "live_vars.json", [this]( const fs::path &path ) {
-		bag().load( path );
+		bag().scheduleReload( path );
 	} );
 }
 
 void DemoApp::update()
 {
+	bag().update();
+
 	float time = app::getElapsedSeconds();
 	auto acc = mPerlinAmplitude() * vec2( mPerlin.dfBm( vec3( mPerlinScale() * vec2( mDisk.mPos.x, mDisk.mPos.y ), mPerlinSpeed * time ) ) );
 	mDisk.mVel += acc + mSpringK() * ( vec2( app::getWindowSize() / 2 ) - mDisk.mPos );
@@ -76,6 +80,9 @@ void DemoApp::keyDown( KeyEvent event )
 	else if( event.getCode() == KeyEvent::KEY_r ) {
 		mDisk.mPos = vec2( app::getWindowSize() / 2 );
 	}
+	else if( event.getCode() == KeyEvent::KEY_b ) {
+		runBenchmarks( app::console() );
+	}
 }
 
 CINDER_APP( DemoApp, RendererGl )
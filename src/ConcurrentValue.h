@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <type_traits>
+
+namespace cinder {
+
+	/**
+	 * A value written by a single thread and read consistently from any thread.
+	 *
+	 * Trivially copyable values are published through a seqlock: the writer never
+	 * blocks and readers retry only when they overlap a write. Other values (strings,
+	 * vectors) are published as immutable copies through an atomic shared_ptr.
+	 */
+	template<typename T, bool = std::is_trivially_copyable<T>::value>
+	class ConcurrentValue;
+
+	template<typename T>
+	class ConcurrentValue<T, true> {
+	public:
+		explicit ConcurrentValue( const T& value )
+		: mSequence{ 0 }
+		{
+			store( value );
+		}
+
+		//! Single writer only.
+		void store( const T& value )
+		{
+			uint32_t words[WORD_COUNT] = {};
+			std::memcpy( words, &value, sizeof( T ) );
+
+			const uint32_t sequence = mSequence.load( std::memory_order_relaxed );
+			mSequence.store( sequence + 1, std::memory_order_relaxed );
+			std::atomic_thread_fence( std::memory_order_release );
+			for( size_t i = 0; i < WORD_COUNT; ++i )
+				mWords[i].store( words[i], std::memory_order_relaxed );
+			mSequence.store( sequence + 2, std::memory_order_release );
+		}
+
+		T load() const
+		{
+			uint32_t words[WORD_COUNT];
+			for( ;; ) {
+				const uint32_t sequence = mSequence.load( std::memory_order_acquire );
+				if( sequence & 1 ) {
+					std::this_thread::yield();
+					continue;
+				}
+				for( size_t i = 0; i < WORD_COUNT; ++i )
+					words[i] = mWords[i].load( std::memory_order_relaxed );
+				std::atomic_thread_fence( std::memory_order_acquire );
+				if( mSequence.load( std::memory_order_relaxed ) == sequence )
+					break;
+			}
+
+			T value;
+			std::memcpy( &value, words, sizeof( T ) );
+			return value;
+		}
+
+	private:
+		static const size_t WORD_COUNT = ( sizeof( T ) + sizeof( uint32_t ) - 1 ) / sizeof( uint32_t );
+
+		std::atomic<uint32_t>	mSequence;
+		std::atomic<uint32_t>	mWords[WORD_COUNT];
+	};
+
+	template<typename T>
+	class ConcurrentValue<T, false> {
+	public:
+		explicit ConcurrentValue( const T& value )
+		{
+			store( value );
+		}
+
+		//! Single writer only.
+		void store( const T& value )
+		{
+			std::atomic_store_explicit( &mPublished, std::make_shared<const T>( value ), std::memory_order_release );
+		}
+
+		T load() const
+		{
+			return *acquire();
+		}
+
+		//! Keeps the published copy alive without copying it.
+		std::shared_ptr<const T> acquire() const
+		{
+			return std::atomic_load_explicit( &mPublished, std::memory_order_acquire );
+		}
+
+	private:
+		std::shared_ptr<const T>	mPublished;
+	};
+
+} //namespace cinder
@@ -11,6 +11,8 @@ namespace cinder
 		: VarBase{ target }
 		{}
 
+		virtual VarType getType() const override { return VarType::Dynamic; }
+
 		virtual const std::string & objectName() const = 0;
 		virtual void setObjectName(const std::string & newName) = 0;
 
@@ -31,10 +33,14 @@ namespace cinder
 	class DynamicVar : public DynamicVarBase {
 	public:
 		DynamicVar( DynamicVarContainer<T> * container, const std::string& name, const std::string& groupName = "default" )
+		: DynamicVar{ ci::bag(), container, name, groupName }
+		{}
+		/// Registers the var in \a bag instead of the default bag().
+		DynamicVar( JsonBag& bag, DynamicVarContainer<T> * container, const std::string& name, const std::string& groupName = "default" )
 		: DynamicVarBase{ &mValue }
 		, mContainer{ container }
 		{
-			ci::bag().emplace( this, name, groupName );
+			bag.emplace( this, name, groupName );
 
 			mContainer->Created.connect([this] (T * object, const std::string & name)
 			{
@@ -93,9 +99,9 @@ namespace cinder
 			tree->addChild( JsonTree { name, mSerializedValue } );
 		}
 
-		virtual void load( const ci::JsonTree& tree ) override
+		virtual void load( const VarDocument::Value& value ) override
 		{
-			mSerializedValue = tree.getValue();
+			mSerializedValue = std::string{ value.text };
 			update(mContainer->get(mSerializedValue));
 		}
 
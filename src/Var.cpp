@@ -2,561 +2,2365 @@
 #include "DynamicVar.h"
 #include "DynamicVarContainer.h"
 #include "cinder/Filesystem.h"
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
 #include <fstream>
+#include <limits>
 
+#include <set>
 #include <unordered_set>
 
 #include "cinder/app/App.h"
 
 static const char * DYNAMIC_OBJECTS_TAG = "__dynamics__";
 
+// mLoadedHash of a var that was never loaded / whose key was missing from the last document
+static const size_t UNLOADED_VALUE_HASH = 0;
+static const size_t MISSING_VALUE_HASH = 1;
+
+// recorded changes are handed to the worker thread in chunks of this size
+static const size_t RECORD_FLUSH_SIZE = 64 * 1024;
+
+// attempts to reload a file that does not parse (e.g. still being written) before waiting for its next change
+static const int MAX_RELOAD_RETRIES = 3;
+
+// Apple's libc++ only has the floating-point std::to_chars / std::from_chars from macOS 13.3 on,
+// older targets use the C library, which assumes the "C" locale
+#if ! defined( VAR_FLOAT_CHARCONV )
+	#if defined( __APPLE__ ) && defined( __ENVIRONMENT_MAC_OS_X_VERSION_MIN_REQUIRED__ ) && __ENVIRONMENT_MAC_OS_X_VERSION_MIN_REQUIRED__ < 130300
+		#define VAR_FLOAT_CHARCONV 0
+	#else
+		#define VAR_FLOAT_CHARCONV 1
+	#endif
+#endif
+
 using namespace ci;
 
+namespace
+{
+	// the items lock of a bag that writes the values of its vars itself, from a document, a transition, a
+	// replay or a remote value: VarBase::callUpdateFn() counts these writes and leaves the file hashes to the bag
+	class ValueWriteLock
+	{
+	public:
+		ValueWriteLock(std::mutex& mutex, const JsonBag* bag)
+		: mLock(mutex), mBag(bag), mWrites(0), mPrevious(sCurrent)
+		{
+			sCurrent = this;
+		}
+		~ValueWriteLock()
+		{
+			unlock();
+		}
+
+		void unlock()
+		{
+			if(mLock.owns_lock())
+			{
+				sCurrent = mPrevious;
+				mLock.unlock();
+			}
+		}
+		size_t getWrites() const { return mWrites; }
+
+		//! Returns the lock held by \a bag on this thread, if any.
+		static ValueWriteLock* find(const JsonBag* bag)
+		{
+			return sCurrent && sCurrent->mBag == bag ? sCurrent : nullptr;
+		}
+		void addWrite() { ++mWrites; }
+
+	private:
+		std::unique_lock<std::mutex>	mLock;
+		const JsonBag*					mBag;
+		size_t							mWrites;
+		ValueWriteLock*					mPrevious;
+
+		static thread_local ValueWriteLock* sCurrent;
+	};
+
+	thread_local ValueWriteLock* ValueWriteLock::sCurrent = nullptr;
+}
+
 JsonBag& ci::bag()
 {
-	static JsonBag instance;
-	return instance;
+	static JsonBag instance;
+	return instance;
+}
+
+JsonBag::JsonBag()
+: mRegistryGeneration{ 0 }
+, mApplyGeneration{ 0 }
+, mVersion{ 0 }
+, mIsLoaded{ false }
+, mIncrementalReload{ false }
+, mSnapshotEnabled{ false }
+, mSkippedReloads{ 0 }
+, mReloadQuietWindow{ std::chrono::milliseconds( 100 ) }
+, mTransactionThread{ std::thread::id{} }
+, mTransactionDepth{ 0 }
+, mPropagationOrderDirty{ false }
+, mSharedMemoryWriter{ false }
+, mSharedMemoryMode{ 0600 }
+, mSharedVarsGeneration{ ~uint64_t( 0 ) }
+, mReplayOriginalSpeed{ true }
+, mReplayVarsGeneration{ ~uint64_t( 0 ) }
+, mRecording{ false }
+, mNextRecordHandle{ 0 }
+, mRecordFramePending{ false }
+, mWorkerJobs{ 16 }
+, mParsedDocuments{ 4 }
+, mMaxVarsPerUpdate{ 0 }
+{
+}
+
+JsonBag::~JsonBag()
+{
+	stopListening();
+	closeSharedMemory();
+	stopRecording();
+
+	// let the pending jobs finish, so that a save requested right before exiting is not lost
+	mParsedDocuments.cancel();
+	if( mWorkerThread ) {
+		mWorkerJobs.pushFront( {} );
+		mWorkerThread->join();
+	}
+	if( mSaveThread ) {
+		postSave( {} );
+		mSaveThread->join();
+	}
+
+	std::lock_guard<std::mutex> lock( mItemsMutex );
+	for( auto& group : mItems ) {
+		for( auto& item : group.second ) {
+			item.second->disconnect();
+			item.second->disconnectOutputs();
+			item.second->setOwner( nullptr );
+		}
+	}
+}
+
+void JsonBag::setFilepath( const fs::path & filepath )
+{
+	std::lock_guard<std::mutex> lock( mPathMutex );
+	mJsonFilePath = filepath;
+}
+
+const fs::path & cinder::JsonBag::getFilepath() const
+{
+	std::lock_guard<std::mutex> lock( mPathMutex );
+	return mJsonFilePath;
+}
+
+void cinder::JsonBag::addDynamicVarContainer(std::string name, IDynamicVarContainer * container)
+{
+	std::lock_guard<std::mutex> lock( mFactoryProviderMutex );
+	mDynamicVarContainers.emplace(std::move(name), container);
+}
+
+namespace
+{
+	bool splitName(const std::string & name, std::string * group, std::string * var, char separator = '.')
+	{
+		const auto index = name.find(separator);
+		if(index == std::string::npos)
+		{
+			return false;
+		}
+		*group = name.substr(0, index);
+		*var = name.substr(index+1);
+		return true;
+	}
+
+	// keep clear of the reserved hashes
+	size_t toLoadedHash(uint64_t hash)
+	{
+		const auto result = static_cast<size_t>(hash ^ (hash >> 32));
+		return result > MISSING_VALUE_HASH ? result : result + MISSING_VALUE_HASH + 1;
+	}
+
+	double secondsSince(std::chrono::steady_clock::time_point startTime)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	// shortest text that reads back to the exact same value
+	template <class T>
+	void appendNumber(std::string * text, T value)
+	{
+		char buffer[32];
+#if ! VAR_FLOAT_CHARCONV
+		if constexpr(std::is_floating_point<T>::value)
+		{
+			// the lowest precision that reads back to the same value
+			for(int precision = std::numeric_limits<T>::digits10; ; ++precision)
+			{
+				const int size = std::snprintf(buffer, sizeof(buffer), "%.*g", precision, static_cast<double>(value));
+				const T readValue = static_cast<T>(std::strtod(buffer, nullptr));
+				if(readValue == value || precision >= std::numeric_limits<T>::max_digits10)
+				{
+					text->append(buffer, size);
+					return;
+				}
+			}
+		}
+		else
+#endif
+		{
+			const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+			text->append(buffer, result.ptr);
+		}
+	}
+
+	template <class T>
+	std::string formatNumber(T value)
+	{
+		std::string text;
+		appendNumber(&text, value);
+		return text;
+	}
+
+	const char * skipSpaces(const char * it, const char * end)
+	{
+		while(it != end && std::isspace(static_cast<unsigned char>(*it)))
+		{
+			++it;
+		}
+		return it;
+	}
+
+	// accepts what stream extraction used to: leading spaces and '+', trailing characters are ignored
+	template <class T>
+	const char * readNumber(const char * it, const char * end, T * value)
+	{
+		it = skipSpaces(it, end);
+		if(it != end && *it == '+')
+		{
+			++it;
+		}
+#if ! VAR_FLOAT_CHARCONV
+		if constexpr(std::is_floating_point<T>::value)
+		{
+			// strtod needs a terminated string, a longer number is cut and fails to round-trip anyway
+			char buffer[64];
+			const size_t size = std::min<size_t>(end - it, sizeof(buffer) - 1);
+			std::memcpy(buffer, it, size);
+			buffer[size] = '\0';
+			if(size == 0 || std::isspace(static_cast<unsigned char>(buffer[0])))
+			{
+				return nullptr;
+			}
+			char * parsedEnd;
+			errno = 0;
+			if constexpr(std::is_same<T, float>::value)
+			{
+				*value = std::strtof(buffer, &parsedEnd);
+			}
+			else
+			{
+				*value = static_cast<T>(std::strtod(buffer, &parsedEnd));
+			}
+			return parsedEnd != buffer && errno != ERANGE ? it + (parsedEnd - buffer) : nullptr;
+		}
+		else
+#endif
+		{
+			const auto result = std::from_chars(it, end, *value);
+			return result.ec == std::errc() ? result.ptr : nullptr;
+		}
+	}
+
+	template <class T>
+	T parseNumber(std::string_view text)
+	{
+		T value{};
+		if(!readNumber(text.data(), text.data() + text.size(), &value))
+		{
+			throw JsonTree::ExcJsonParserError("\"" + std::string{ text } + "\" is not a number");
+		}
+		return value;
+	}
+
+	bool parseBool(std::string_view text)
+	{
+		if(text == "true" || text == "1")
+		{
+			return true;
+		}
+		if(text == "false" || text == "0")
+		{
+			return false;
+		}
+		throw JsonTree::ExcJsonParserError("\"" + std::string{ text } + "\" is not a boolean");
+	}
+}
+
+VarBase * JsonBag::findVar(std::string_view fullName) const
+{
+	std::lock_guard<std::mutex> lock( mItemsMutex );
+	return findVarLocked(fullName);
+}
+
+VarBase * JsonBag::findVarLocked(std::string_view fullName) const
+{
+	if(auto var = mRegistry.find(fullName))
+	{
+		return var;
+	}
+
+	// not found: only allocate for the diagnostic
+	std::string groupName, varName;
+	if(!splitName(std::string{ fullName }, &groupName, &varName))
+	{
+		CI_LOG_E("cannot parse \"" + std::string{ fullName } + "\". Must be \"group.varName\"");
+	}
+	else if(!mItems.count(groupName))
+	{
+		CI_LOG_W("group \"" + groupName + "\" not found");
+	}
+	else
+	{
+		CI_LOG_W("var \"" + varName + "\" not found in group \"" + groupName + "\"");
+	}
+	return nullptr;
+}
+
+bool JsonBag::findVarName(const VarBase * var, std::string *name, std::string *groupName) const
+{
+	if(!var || var->mOwner != this)
+	{
+		return false;
+	}
+
+	if(groupName)
+	{
+		*groupName = var->getGroupName();
+	}
+	if(name)
+	{
+		*name = var->getName();
+	}
+	return true;
+}
+
+void JsonBag::emplace( VarBase* var, const std::string &name, const std::string groupName )
+{
+	std::lock_guard<std::mutex> lock( mItemsMutex );
+
+	auto groupIt = mItems.emplace( groupName, VarMap::mapped_type{} ).first;
+	const auto inserted = groupIt->second.emplace( name, var );
+	if( ! inserted.second ) {
+		CI_LOG_E( "Bag already contains '" + name + "' in group '" + groupName + "', not adding." );
+		return;
+	}
+	
+	// "a.b" / "c" and "a" / "b.c" share their full name
+	if( ! mRegistry.insert( groupName, name, var, &var->mRegistrySlot ) ) {
+		CI_LOG_E( "Bag already contains a var named '" + groupName + VarRegistry::SEPARATOR + name + "', not adding." );
+		groupIt->second.erase( inserted.first );
+		if( groupIt->second.empty() )
+			mItems.erase( groupIt );
+		return;
+	}
+	++mRegistryGeneration;
+	mGroupHashes.erase( groupName );
+	var->mGroupIt = groupIt;
+	var->mItemIt = inserted.first;
+	var->setOwner( this );
+}
+
+void JsonBag::remove( VarBase* var )
+{
+	std::lock_guard<std::mutex> lock( mItemsMutex );
+	removeLocked( var );
+}
+
+void JsonBag::removeLocked( VarBase* var )
+{
+	if( var->mOwner != this )
+		return;
+
+	mRegistry.eraseAt( var->mRegistrySlot );
+	var->mRegistrySlot = VarRegistry::NO_SLOT;
+	++mRegistryGeneration;
+	forgetRecordedVar( var );
+	{
+		std::lock_guard<std::mutex> lock( mSharedMutex );
+		mSharedChangedVars.erase( var );
+	}
+	cancelNotification( var );
+	mTransitions.cancel( &var->mTransitionIndex );
+	var->disconnect();
+	var->disconnectOutputs();
+
+	auto groupIt = var->mGroupIt;
+	groupIt->second.erase( var->mItemIt );
+	if( groupIt->second.empty() ) {
+		mGroupHashes.erase( groupIt->first );
+		mItems.erase( groupIt );
+	}
+
+	var->setOwner( nullptr );
+}
+
+void JsonBag::remove( const std::vector<VarBase*>& vars )
+{
+	std::lock_guard<std::mutex> lock( mItemsMutex );
+	for( auto var : vars ) {
+		if( var )
+			removeLocked( var );
+	}
+}
+
+void JsonBag::removeGroup( const std::string& groupName )
+{
+	std::lock_guard<std::mutex> lock( mItemsMutex );
+	auto groupIt = mItems.find( groupName );
+	if( groupIt == mItems.end() )
+		return;
+
+	// removeLocked() erases the group with its last var
+	std::vector<VarBase*> vars;
+	vars.reserve( groupIt->second.size() );
+	for( const auto& item : groupIt->second )
+		vars.push_back( item.second );
+	for( auto var : vars )
+		removeLocked( var );
+}
+
+void JsonBag::beginTransaction()
+{
+	// the depth and the lists are only read by the transaction's thread, the other threads only see its id
+	const auto thread = std::this_thread::get_id();
+	const auto running = mTransactionThread.load();
+	CI_ASSERT_MSG( running == std::thread::id{} || running == thread, "Transactions are limited to one thread at a time" );
+	mTransactionThread = thread;
+	++mTransactionDepth;
+}
+
+void JsonBag::endTransaction()
+{
+	CI_ASSERT( mTransactionDepth > 0 && mTransactionThread == std::this_thread::get_id() );
+	if( mTransactionDepth > 1 ) {
+		--mTransactionDepth;
+		return;
+	}
+
+	// still deferring: the values of connected vars are pulled in topological order, then every changed
+	// var is notified once. Vars changed by the callbacks are handled in a following round.
+	std::unordered_set<VarBase*> notified;
+	for( size_t begin = 0; begin < mPendingNotifications.size(); ) {
+		propagateConnections();
+
+		const size_t end = mPendingNotifications.size();
+		for( size_t i = begin; i < end; ++i ) {
+			VarBase* var = mPendingNotifications[i];
+			if( ! var )
+				continue; // removed by a previous callback
+			var->mNotificationPending = false;
+			if( notified.insert( var ).second )
+				mChangedVars.push_back( var );
+			var->mUpdateFn.emit();
+		}
+		begin = end;
+	}
+	mPendingNotifications.clear();
+
+	std::vector<VarBase*> changedVars;
+	std::swap( changedVars, mChangedVars );
+	changedVars.erase( std::remove( changedVars.begin(), changedVars.end(), nullptr ), changedVars.end() );
+
+	mTransactionDepth = 0;
+	mTransactionThread = std::thread::id{};
+
+	if( changedVars.empty() )
+		return;
+
+	if( ! mGroupSignalsChanged.empty() ) {
+		std::map<std::string, std::vector<VarBase*>> changedGroups;
+		for( auto var : changedVars ) {
+			if( mGroupSignalsChanged.count( var->getGroupName() ) )
+				changedGroups[var->getGroupName()].push_back( var );
+		}
+		for( const auto& group : changedGroups )
+			mGroupSignalsChanged[group.first].emit( group.second );
+	}
+	mSignalChanged.emit( changedVars );
+}
+
+void JsonBag::propagateConnections()
+{
+	if( mPropagationOrderDirty.exchange( false ) ) {
+		std::lock_guard<std::mutex> lock( mItemsMutex );
+		// an input is always closer to the root of its chain than its outputs (connections form no cycle)
+		std::vector<std::pair<size_t, VarBase*>> connectedVars;
+		for( const auto& group : mItems ) {
+			for( const auto& item : group.second ) {
+				size_t depth = 0;
+				for( auto input = item.second->mConnectedInput; input; input = input->mConnectedInput )
+					++depth;
+				if( depth )
+					connectedVars.emplace_back( depth, item.second );
+			}
+		}
+		std::stable_sort( connectedVars.begin(), connectedVars.end(), [] ( const auto& left, const auto& right ) {
+			return left.first < right.first;
+		} );
+
+		mPropagationOrder.clear();
+		for( const auto& connectedVar : connectedVars )
+			mPropagationOrder.push_back( connectedVar.second );
+	}
+
+	// each output is evaluated at most once, after its input got its final value
+	for( auto var : mPropagationOrder ) {
+		if( var->mConnectedInput && var->mConnectedInput->mNotificationPending )
+			var->mPullInput();
+	}
+}
+
+JsonBag::ChangedSignal& JsonBag::getSignalGroupChanged( const std::string& groupName )
+{
+	return mGroupSignalsChanged[groupName];
+}
+
+void JsonBag::deferNotification( VarBase* var )
+{
+	if( ! var->mNotificationPending ) {
+		var->mNotificationPending = true;
+		mPendingNotifications.push_back( var );
+	}
+}
+
+void JsonBag::cancelNotification( VarBase* var )
+{
+	// outside of a transaction no notification is pending. The lists are not synchronized: during a transaction,
+	// its vars are only destroyed by its thread, e.g. from a callback
+	const auto thread = mTransactionThread.load();
+	if( thread == std::thread::id{} )
+		return;
+	CI_ASSERT_MSG( thread == std::this_thread::get_id(), "A var was destroyed during a transaction of another thread" );
+	if( thread != std::this_thread::get_id() )
+		return;
+
+	// nulled rather than erased, endTransaction() may be iterating
+	var->mNotificationPending = false;
+	std::replace( mPendingNotifications.begin(), mPendingNotifications.end(), var, static_cast<VarBase*>( nullptr ) );
+	std::replace( mChangedVars.begin(), mChangedVars.end(), var, static_cast<VarBase*>( nullptr ) );
+}
+
+std::future<bool> JsonBag::save()
+{
+	fs::path p;
+	{
+		std::lock_guard<std::mutex> lock( mPathMutex );
+		if( ! mShardDirectory.empty() )
+			return saveShards();
+		CI_ASSERT( fs::is_regular_file( mJsonFilePath ) );
+		p = mJsonFilePath;
+	}
+	return save( p );
+}
+
+std::future<bool> JsonBag::save( const fs::path& path )
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	auto state = captureState();
+	const double captureTime = secondsSince( startTime );
+	std::vector<size_t> groups( state->groups.size() );
+	for( size_t i = 0; i < groups.size(); ++i )
+		groups[i] = i;
+
+	auto promise = std::make_shared<std::promise<bool>>();
+	auto result = promise->get_future();
+	postSave( [this, state, groups, path, captureTime, promise] { promise->set_value( write( *state, groups, true, path, captureTime ) ); } );
+	return result;
+}
+
+std::future<bool> JsonBag::saveShards()
+{
+	// called with mPathMutex held
+	const auto startTime = std::chrono::steady_clock::now();
+	auto state = captureState();
+	const double captureTime = secondsSince( startTime );
+
+	// shard name -> indices of its groups in state
+	std::map<std::string, std::vector<size_t>> shards;
+	for( size_t i = 0; i < state->groups.size(); ++i )
+		shards[getShardName( state->groups[i].first )].push_back( i );
+	if( state->dynamics )
+		shards[DYNAMIC_OBJECTS_TAG];
+
+	// only the shards whose content changed since they were last loaded or saved
+	std::vector<std::pair<fs::path, std::vector<size_t>>> dirtyShards;
+	for( auto& shard : shards ) {
+		const bool dynamics = shard.first == DYNAMIC_OBJECTS_TAG;
+		const uint64_t hash = hashShard( *state, shard.second, dynamics );
+		auto hashIt = mShardHashes.find( shard.first );
+		if( hashIt != mShardHashes.end() && hashIt->second == hash )
+			continue;
+		mShardHashes[shard.first] = hash;
+		dirtyShards.emplace_back( getShardPath( shard.first ), std::move( shard.second ) );
+	}
+
+	auto promise = std::make_shared<std::promise<bool>>();
+	auto result = promise->get_future();
+	if( dirtyShards.empty() ) {
+		promise->set_value( true );
+		return result;
+	}
+
+	postSave( [this, state, dirtyShards, captureTime, promise] {
+		bool success = true;
+		for( const auto& shard : dirtyShards ) {
+			const bool dynamics = shard.second.empty();
+			// the capture is shared by the shards, reported once
+			if( ! write( *state, shard.second, dynamics, shard.first, &shard == &dirtyShards.front() ? captureTime : 0.0 ) ) {
+				success = false;
+				// written again by the next save
+				std::lock_guard<std::mutex> lock( mPathMutex );
+				mShardHashes.erase( dynamics ? std::string( DYNAMIC_OBJECTS_TAG ) : getShardName( state->groups[shard.second.front()].first ) );
+			}
+		}
+		promise->set_value( success );
+	} );
+	return result;
+}
+
+std::shared_ptr<JsonBag::SavedState> JsonBag::captureState( const std::set<std::string>* groupNames )
+{
+	// only copy the values here: formatting and writing happen on the worker thread
+	auto state = std::make_shared<SavedState>();
+	state->version = mVersion;
+
+	if( ! groupNames )
+	{
+		std::lock_guard<std::mutex> lock(mFactoryProviderMutex);
+		if(!mDynamicVarContainers.empty())
+		{
+			state->dynamics.reset(new JsonTree(JsonTree::makeObject(DYNAMIC_OBJECTS_TAG)));
+			for(const auto & item : mDynamicVarContainers)
+			{
+				const auto & name = item.first;
+				const auto & container = item.second;
+				JsonTree objectList = JsonTree::makeObject(name);
+
+				for(const auto& item : container->getContentForSave())
+				{
+					objectList.addChild(JsonTree{ item.name, item.typeParams });
+				}
+				state->dynamics->addChild(objectList);
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> lock( mItemsMutex );
+	state->applyGeneration = mApplyGeneration;
+	state->groups.reserve( groupNames ? groupNames->size() : mItems.size() );
+	for( const auto& group : mItems ) {
+		if( groupNames && ! groupNames->count( group.first ) )
+			continue;
+
+		state->groups.emplace_back( group.first, std::vector<SavedVar>{} );
+		auto& savedVars = state->groups.back().second;
+		savedVars.reserve( group.second.size() );
+		for( const auto& item : group.second ) {
+			const VarBase* var = item.second;
+			SavedVar savedVar{ item.first, VarType::Unknown, state->binary.size(), 0, {}, nullptr };
+			if( auto input = var->getConnectedInput() ) {
+				const auto& groupName = input->getGroupName();
+				savedVar.connection = "=" + ( groupName.empty() ? input->getName() : ( groupName + '.' + input->getName() ) );
+			}
+			else if( var->getType() != VarType::Unknown && var->getType() != VarType::Dynamic && var->saveBinary( &state->binary ) ) {
+				savedVar.type = var->getType();
+				savedVar.size = state->binary.size() - savedVar.offset;
+			}
+			else {
+				savedVar.json.reset( new JsonTree( JsonTree::makeArray( group.first ) ) );
+				var->save( item.first, savedVar.json.get() );
+			}
+			savedVars.push_back( std::move( savedVar ) );
+		}
+	}
+	return state;
+}
+
+uint64_t JsonBag::hashShard( const SavedState& state, const std::vector<size_t>& groups, bool dynamics )
+{
+	uint64_t hash = VarRegistry::hash( dynamics && state.dynamics ? state.dynamics->serialize() : std::string{} );
+	for( const size_t index : groups ) {
+		const auto& group = state.groups[index];
+		hash = VarRegistry::hash( group.first, hash );
+		for( const auto& savedVar : group.second ) {
+			hash = VarRegistry::hash( savedVar.name, hash );
+			hash = VarRegistry::hash( savedVar.connection, hash );
+			hash = VarRegistry::hash( { state.binary.data() + savedVar.offset, savedVar.size }, hash );
+			if( savedVar.json )
+				hash = VarRegistry::hash( savedVar.json->serialize(), hash );
+		}
+	}
+	return hash;
+}
+
+bool JsonBag::write( const SavedState& state, const std::vector<size_t>& groups, bool dynamics, const fs::path& path, double captureTime )
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	VarEvent event;
+	event.type = VarEvent::Type::Save;
+	event.path = path;
+	event.captureTime = captureTime;
+
+	JsonTree doc;
+	if( dynamics && state.dynamics )
+		doc.addChild( *state.dynamics );
+
+	for( const size_t index : groups ) {
+		const auto& group = state.groups[index];
+		JsonTree jsonGroup = JsonTree::makeArray( group.first );
+		for( const auto& savedVar : group.second ) {
+			if( ! savedVar.connection.empty() )
+				jsonGroup.addChild( JsonTree( savedVar.name, savedVar.connection ) );
+			else if( savedVar.json ) {
+				for( const auto& child : savedVar.json->getChildren() )
+					jsonGroup.addChild( child );
+			}
+			else
+				writeBinary( savedVar.type, { state.binary.data() + savedVar.offset, savedVar.size }, savedVar.name, &jsonGroup );
+		}
+		doc.pushBack( jsonGroup );
+	}
+	doc.addChild( JsonTree{ "version", state.version } );
+
+	// write aside then rename, the previous file stays intact until the new one is complete
+	auto tempPath = path;
+	tempPath += ".tmp";
+	const std::string text = doc.serialize();
+	{
+		std::ofstream file( tempPath, std::ios::binary | std::ios::trunc );
+		file.write( text.data(), text.size() );
+		file.close();
+		if( ! file ) {
+			CI_LOG_E( "Failed to write " + tempPath.string() );
+			event.writeTime = secondsSince( startTime );
+			report( event );
+			return false;
+		}
+	}
+
+	// recorded before the rename, which the file watcher may report right away
+	const auto key = normalizePath( path );
+	WrittenFile written;
+	written.hash = VarRegistry::hash( text );
+	const bool hasState = VarDocument::getFileState( tempPath, &written.size, &written.time );
+	{
+		std::lock_guard<std::mutex> lock( mLastWriteMutex );
+		if( hasState )
+			mLastWrites[key] = written;
+		else
+			mLastWrites.erase( key );
+	}
+
+	std::error_code error;
+	fs::rename( tempPath, path, error );
+	if( error ) {
+		std::lock_guard<std::mutex> lock( mLastWriteMutex );
+		mLastWrites.erase( key );
+		CI_LOG_E( "Failed to replace " + path.string() + ". " + error.message() );
+	}
+	else {
+		event.success = true;
+		event.bytes = text.size();
+		queueLoadedHashes( path, text, state.applyGeneration );
+	}
+	event.writeTime = secondsSince( startTime );
+	report( event );
+	return event.success;
+}
+
+void JsonBag::queueLoadedHashes( const fs::path& path, const std::string& text, uint64_t applyGeneration )
+{
+	// only the bag's own file is reloaded into its vars, a copy saved elsewhere leaves them as they are
+	if( ! isShard( path ) ) {
+		std::lock_guard<std::mutex> lock( mPathMutex );
+		if( normalizePath( path ) != normalizePath( mJsonFilePath ) )
+			return;
+	}
+
+	std::shared_ptr<VarDocument> doc;
+	try {
+		doc = VarDocument::parse( std::vector<char>( text.begin(), text.end() ) );
+	}
+	catch( const JsonTree::ExcJsonParserError& exc ) {
+		CI_LOG_E( "Failed to parse the saved values. " + std::string( exc.what() ) );
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock( mLastWriteMutex );
+	mSavedDocuments.push_back( { doc, applyGeneration } );
+}
+
+void JsonBag::updateLoadedHashes()
+{
+	// the file now holds the saved values: the next load compares its content to them, not to the values
+	// loaded before the save, which the reload of our own write skipped
+	std::vector<SavedDocument> savedDocuments;
+	{
+		std::lock_guard<std::mutex> lock( mLastWriteMutex );
+		std::swap( savedDocuments, mSavedDocuments );
+	}
+
+	std::lock_guard<std::mutex> lock( mItemsMutex );
+	for( const auto& saved : savedDocuments ) {
+		// a load applied since the capture may hold other values than the file
+		if( saved.applyGeneration != mApplyGeneration )
+			continue;
+
+		const VarDocument& doc = *saved.doc;
+		for( const auto& group : doc.getGroups() ) {
+			auto groupIt = mItems.find( std::string{ group.name } );
+			if( groupIt == mItems.end() )
+				continue;
+			// a var detached from the file, or added since, may hold another value than the one saved
+			bool attached = true;
+			for( const auto& item : groupIt->second ) {
+				if( item.second->mLoadedHash == UNLOADED_VALUE_HASH ) {
+					attached = false;
+					continue;
+				}
+				const auto value = doc.find( group.name, item.first );
+				item.second->mLoadedHash = value ? toLoadedHash( value->hash ) : MISSING_VALUE_HASH;
+			}
+			if( attached )
+				mGroupHashes[groupIt->first] = toLoadedHash( group.hash );
+		}
+	}
+}
+
+void JsonBag::detachFromFile( VarBase* var )
+{
+	// called with mItemsMutex held, once a value that is not from a file was applied:
+	// the next load applies the file's value again, even if the file did not change
+	if( var->mLoadedHash == UNLOADED_VALUE_HASH )
+		return;
+	var->mLoadedHash = UNLOADED_VALUE_HASH;
+	mGroupHashes.erase( var->getGroupName() );
+}
+
+bool JsonBag::skipOwnWrite( const fs::path& path )
+{
+	WrittenFile lastWrite;
+	{
+		std::lock_guard<std::mutex> lock( mLastWriteMutex );
+		auto lastWriteIt = mLastWrites.find( normalizePath( path ) );
+		if( lastWriteIt == mLastWrites.end() )
+			return false;
+		lastWrite = lastWriteIt->second;
+	}
+
+	uint64_t size;
+	int64_t time;
+	if( ! VarDocument::getFileState( path, &size, &time ) || size != lastWrite.size )
+		return false;
+
+	if( time != lastWrite.time ) {
+		// touched or copied over since: compare the content
+		std::string text( static_cast<size_t>( size ), '\0' );
+		std::ifstream file( path, std::ios::binary );
+		if( ! file.read( &text[0], text.size() ) || VarRegistry::hash( text ) != lastWrite.hash )
+			return false;
+	}
+
+	++mSkippedReloads;
+	{
+		std::lock_guard<std::mutex> lock( mStatsMutex );
+		++mStats.skippedLoads;
+	}
+	mIsLoaded = true;
+	return true;
+}
+
+VarStats JsonBag::getStats() const
+{
+	std::lock_guard<std::mutex> lock( mStatsMutex );
+	return mStats;
+}
+
+void JsonBag::resetStats()
+{
+	std::lock_guard<std::mutex> lock( mStatsMutex );
+	mStats = VarStats{};
+}
+
+void JsonBag::setEventHook( const std::function<void( const VarEvent& )>& hook )
+{
+	std::lock_guard<std::mutex> lock( mStatsMutex );
+	mEventHook = hook;
+}
+
+void JsonBag::report( const VarEvent& event )
+{
+	std::function<void( const VarEvent& )> hook;
+	{
+		std::lock_guard<std::mutex> lock( mStatsMutex );
+		mStats.add( event );
+		hook = mEventHook;
+	}
+	if( hook )
+		hook( event );
+}
+
+fs::path JsonBag::normalizePath( const fs::path& path )
+{
+	std::error_code error;
+	const auto absolutePath = fs::absolute( path, error );
+	return ( error ? path : absolutePath ).lexically_normal();
+}
+
+void JsonBag::setShardDirectory( const fs::path& directory, const std::function<std::string( const std::string& )>& shardName )
+{
+	std::lock_guard<std::mutex> lock( mPathMutex );
+	mShardDirectory = directory.empty() ? directory : normalizePath( directory );
+	mShardName = shardName;
+	mShardHashes.clear();
+}
+
+fs::path JsonBag::getShardDirectory() const
+{
+	std::lock_guard<std::mutex> lock( mPathMutex );
+	return mShardDirectory;
+}
+
+std::string JsonBag::getShardName( const std::string& groupName ) const
+{
+	return mShardName ? mShardName( groupName ) : groupName;
+}
+
+fs::path JsonBag::getShardPath( const std::string& shardName ) const
+{
+	// keeps the shard names usable as file names
+	std::string fileName = shardName;
+	for( auto& c : fileName ) {
+		if( ! std::isalnum( static_cast<unsigned char>( c ) ) && c != '-' && c != '_' && c != '.' )
+			c = '_';
+	}
+	return mShardDirectory / ( fileName + ".json" );
+}
+
+bool JsonBag::isShard( const fs::path& path ) const
+{
+	std::lock_guard<std::mutex> lock( mPathMutex );
+	return ! mShardDirectory.empty() && normalizePath( path ).parent_path() == mShardDirectory;
+}
+
+void JsonBag::updateShardHashes( const VarDocument& doc )
+{
+	// mPathMutex is taken before mItemsMutex by save(), never inside it
+	std::function<std::string( const std::string& )> shardName;
+	{
+		std::lock_guard<std::mutex> lock( mPathMutex );
+		shardName = mShardName;
+	}
+	const auto getName = [&shardName]( const std::string& groupName ) { return shardName ? shardName( groupName ) : groupName; };
+
+	std::set<std::string> shardNames, groupNames;
+	for( const auto& group : doc.getGroups() ) {
+		if( ! group.name.empty() )
+			shardNames.insert( getName( std::string{ group.name } ) );
+	}
+	{
+		// every registered group of these shards
+		std::lock_guard<std::mutex> lock( mItemsMutex );
+		for( const auto& group : mItems ) {
+			if( shardNames.count( getName( group.first ) ) )
+				groupNames.insert( group.first );
+		}
+	}
+
+	auto state = captureState( &groupNames );
+	std::map<std::string, std::vector<size_t>> shards;
+	for( size_t i = 0; i < state->groups.size(); ++i )
+		shards[getName( state->groups[i].first )].push_back( i );
+
+	std::lock_guard<std::mutex> lock( mPathMutex );
+	for( const auto& shard : shards )
+		mShardHashes[shard.first] = hashShard( *state, shard.second, false );
+}
+
+std::vector<VarBase*> JsonBag::loadShards()
+{
+	const auto directory = getShardDirectory();
+	std::vector<fs::path> paths;
+	std::error_code error;
+	for( fs::directory_iterator it( directory, error ), end; ! error && it != end; it.increment( error ) ) {
+		if( it->is_regular_file() && it->path().extension() == ".json" )
+			paths.push_back( it->path() );
+	}
+	if( error )
+		CI_LOG_E( "Failed to list the shards in " + directory.string() + ". " + error.message() );
+	std::sort( paths.begin(), paths.end() );
+
+	// parse in parallel, then apply in order as a single change
+	std::vector<std::shared_ptr<VarDocument>> docs( paths.size() );
+	std::atomic<size_t> next{ 0 };
+	const auto parse = [&] {
+		for( size_t i = next++; i < paths.size(); i = next++ )
+			docs[i] = read( paths[i] );
+	};
+	const size_t threadCount = std::min<size_t>( std::max( 1u, std::thread::hardware_concurrency() ), paths.size() );
+	std::vector<std::thread> threads;
+	for( size_t i = 1; i < threadCount; ++i ) {
+		threads.emplace_back( [&parse] {
+			ci::ThreadSetup threadSetup;
+			parse();
+		} );
+	}
+	parse();
+	for( auto& thread : threads )
+		thread.join();
+
+	std::vector<VarBase*> changedVars;
+	beginTransaction();
+	for( size_t i = 0; i < paths.size(); ++i ) {
+		const auto shardChangedVars = apply( paths[i], docs[i] );
+		changedVars.insert( changedVars.end(), shardChangedVars.begin(), shardChangedVars.end() );
+	}
+	endTransaction();
+	return changedVars;
+}
+
+std::shared_ptr<VarDocument> JsonBag::read( const fs::path & path, std::string* error ) const
+{
+	if( ! fs::exists( path ) )
+		return nullptr;
+
+	if( mSnapshotEnabled ) {
+		if( auto snapshot = VarDocument::loadSnapshot( path ) )
+			return snapshot;
+	}
+
+	try {
+		return VarDocument::load( path );
+	}
+	catch( const JsonTree::ExcJsonParserError& exc )  {
+		if( error )
+			*error = exc.what();
+		else
+			CI_LOG_E( "Failed to parse json file.\n" + std::string(exc.what()) );
+	}
+	return nullptr;
+}
+
+std::vector<VarBase*> JsonBag::load( const fs::path & path )
+{
+	if( skipOwnWrite( path ) )
+		return {};
+
+	return apply( path, read( path ) );
+}
+
+std::vector<VarBase*> JsonBag::apply( const fs::path & path, const std::shared_ptr<VarDocument>& doc, bool notified )
+{
+	std::vector<VarBase*> changedVars;
+	if( auto pending = beginApply( path, doc, notified ) ) {
+		size_t budget = std::numeric_limits<size_t>::max();
+		applyValues( pending.get(), &budget, &changedVars );
+		finishApply( pending.get() );
+	}
+	return changedVars;
+}
+
+std::unique_ptr<JsonBag::PendingApply> JsonBag::beginApply( const fs::path & path, const std::shared_ptr<VarDocument>& doc, bool notified )
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	std::unique_ptr<PendingApply> pending{ new PendingApply };
+	pending->path = path;
+	pending->doc = doc;
+	pending->notified = notified;
+	pending->event.path = path;
+
+	// a shard only holds some of the groups
+	pending->shard = isShard( path );
+	if( ! pending->shard ) {
+		std::lock_guard<std::mutex> lock( mPathMutex );
+		mJsonFilePath = path;
+	}
+
+	if( ! doc ) {
+		mIsLoaded = true;
+		report( pending->event );
+		return nullptr;
+	}
+	pending->event.success = true;
+	pending->event.bytes = doc->isSnapshot() ? 0 : doc->getSize();
+	pending->event.readTime = doc->getReadTime();
+	pending->event.parseTime = doc->getParseTime();
+
+	if( auto version = doc->find( "", "version" ) ) {
+		try {
+			mVersion = parseNumber<int>( version->text );
+		}
+		catch( const JsonTree::ExcJsonParserError& exc ) {
+			CI_LOG_E( "Invalid version. " + std::string( exc.what() ) );
+		}
+	}
+
+	if(auto dynamics = doc->findGroup(DYNAMIC_OBJECTS_TAG))
+	{
+		CI_ASSERT_MSG(ci::app::isMainThread(), "Dynamic objects do not support async load");
+
+		std::lock_guard<std::mutex> lock(mFactoryProviderMutex);
+		if(!mDynamicVarContainers.empty())
+		{
+			std::vector<IDynamicVarContainer *> toClear;
+			toClear.reserve(mDynamicVarContainers.size());
+			for(const auto & item : mDynamicVarContainers)
+			{
+				toClear.push_back(item.second);
+			}
+
+			for(auto dynamic = doc->begin(*dynamics); dynamic != doc->end(*dynamics); ++dynamic)
+			{
+				const std::string dynamicName{ dynamic->name };
+
+				const auto & dynamicIt = mDynamicVarContainers.find(dynamicName);
+				//const auto & factory = mFactoryProvider->get(factoryName);
+				if(dynamicIt == mDynamicVarContainers.end())
+				{
+					CI_LOG_E( "No dynamic var container for " + dynamicName );
+					continue;
+				}
+				const auto & container = dynamicIt->second;
+
+				std::vector<IDynamicVarContainer::TypeAndName> content;
+				for(const auto & item : *dynamic)
+				{
+					content.push_back({std::string{ item.value }, std::string{ item.key }});
+				}
+				container->loadContent(content);
+
+				const auto toClearIt = std::find(toClear.begin(), toClear.end(), container);
+				if(toClearIt != toClear.end())
+				{
+					toClear.erase(toClearIt);
+				}
+			}
+
+			// clear unreferenced containers
+			for(const auto & container : toClear)
+			{
+				container->loadContent({});
+			}
+		}
+		else
+		{
+			CI_LOG_E( "No dynamic var container provided" );
+		}
+	}
+
+	pending->event.applyTime = secondsSince( startTime );
+	return pending;
+}
+
+bool JsonBag::applyValues( PendingApply* pending, size_t* budget, std::vector<VarBase*>* changedVars )
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	const size_t changedCount = changedVars->size();
+	const VarDocument& doc = *pending->doc;
+	const bool incremental = mIncrementalReload;
+	bool done = true;
+
+	// listeners run once the values are applied, without the items lock
+	beginTransaction();
+	ValueWriteLock lock{ mItemsMutex, this };
+	++mApplyGeneration;
+	for( auto groupIt = mItems.lower_bound( pending->groupName ); groupIt != mItems.end() && done; ++groupIt ) {
+		const std::string& groupName = groupIt->first;
+		const auto groupDoc = doc.findGroup( groupName );
+		if( ! groupDoc ) {
+			if( ! pending->shard ) {
+				mGroupHashes.erase( groupName );
+				CI_LOG_E( "No group named " + groupName );
+			}
+			continue;
+		}
+
+		// skip the whole group when none of its values changed, unless resuming in its middle
+		const size_t groupHash = toLoadedHash( groupDoc->hash );
+		const bool resumed = groupName == pending->groupName && ! pending->name.empty();
+		if( ! resumed ) {
+			auto groupHashIt = mGroupHashes.find( groupName );
+			if( incremental && groupHashIt != mGroupHashes.end() && groupHashIt->second == groupHash )
+				continue;
+		}
+
+		auto& vars = groupIt->second;
+		for( auto varIt = resumed ? vars.lower_bound( pending->name ) : vars.begin(); varIt != vars.end(); ++varIt ) {
+			const std::string& valueName = varIt->first;
+			VarBase* var = varIt->second;
+			const auto value = doc.find( groupName, valueName );
+			const size_t valueHash = value ? toLoadedHash( value->hash ) : MISSING_VALUE_HASH;
+			const bool changed = var->mLoadedHash != valueHash;
+			if( incremental && ! changed )
+				continue;
+			if( *budget == 0 ) {
+				// continued from this var by the next call
+				pending->groupName = groupName;
+				pending->name = valueName;
+				done = false;
+				break;
+			}
+			--*budget;
+			var->mLoadedHash = valueHash;
+			// only the vars whose value was written, the file may hold the value they already have
+			const size_t writes = lock.getWrites();
+
+			if( ! value ) {
+				++pending->event.varsDefaulted;
+				CI_LOG_I( "No item named " + valueName + ": restore default value" );
+				mTransitions.cancel( &var->mTransitionIndex );
+				var->restoreDefault();
+				if( lock.getWrites() != writes )
+					changedVars->push_back( var );
+				continue;
+			}
+
+			var->disconnect();
+
+			const auto & text = value->text;
+			if( ! text.empty() && text.front() == '=' ) { // is connection
+				// before the input's value is assigned, which would cancel it under the items lock
+				mTransitions.cancel( &var->mTransitionIndex );
+				const auto inputName = text.substr( 1 );
+				const auto inputVar = findVarLocked( inputName );
+				if( ! inputVar ) {
+					CI_LOG_E( std::string( inputName ) + " not found. Connection failed." );
+				}
+				else if( ! var->tryConnectFrom( inputVar ) ) {
+					CI_LOG_E( std::string( inputName ) + " cannot be connected to " + groupName + "." + valueName + ". Connection failed." );
+				}
+			}
+			else { // load value
+				try {
+					if( startTransition( var, *value ) ) {
+						// written by the following updates
+						changedVars->push_back( var );
+						continue;
+					}
+					mTransitions.cancel( &var->mTransitionIndex );
+					// snapshots hold the binary form of the values, as long as the var type did not change
+					if( value->binaryType == VarType::Unknown || value->binaryType != var->getType() || ! var->loadBinary( value->binary ) )
+						var->load( *value );
+				}
+				catch( const JsonTree::ExcJsonParserError& exc ) {
+					CI_LOG_E( "Failed to load " + groupName + "." + valueName + ". " + exc.what() );
+				}
+			}
+			if( lock.getWrites() != writes )
+				changedVars->push_back( var );
+		}
+
+		if( done ) {
+			// once all of its values are applied
+			mGroupHashes[groupName] = groupHash;
+			pending->name.clear();
+		}
+	}
+
+	if( done && mSnapshotEnabled && ! doc.isSnapshot() )
+		writeSnapshot( pending->doc );
+
+	lock.unlock();
+	const auto applyEndTime = std::chrono::steady_clock::now();
+	endTransaction();
+	pending->event.applyTime += std::chrono::duration<double>( applyEndTime - startTime ).count();
+	pending->event.callbackTime += secondsSince( applyEndTime );
+	pending->event.varsChanged += changedVars->size() - changedCount;
+	return done;
+}
+
+void JsonBag::finishApply( PendingApply* pending )
+{
+	const VarDocument& doc = *pending->doc;
+	if( doc.getSourceTime() != 0 ) {
+		// only a change notification of a file loaded before tells when the file was modified: the time of
+		// an initial load or of a file that did not change is its age
+		int64_t previousSourceTime;
+		{
+			std::lock_guard<std::mutex> lock( mStatsMutex );
+			auto& appliedSourceTime = mAppliedSourceTimes[normalizePath( pending->path )];
+			previousSourceTime = appliedSourceTime;
+			appliedSourceTime = doc.getSourceTime();
+		}
+		if( pending->notified && previousSourceTime != 0 && previousSourceTime != doc.getSourceTime() ) {
+			const fs::file_time_type sourceTime{ fs::file_time_type::duration{ doc.getSourceTime() } };
+			pending->event.latency = std::chrono::duration<double>( fs::file_time_type::clock::now() - sourceTime ).count();
+		}
+	}
+
+	if( pending->shard )
+		updateShardHashes( doc );
+
+	mIsLoaded = true;
+	report( pending->event );
+}
+
+void JsonBag::writeSnapshot( const std::shared_ptr<VarDocument>& doc )
+{
+	// called with mItemsMutex held: the registered vars give the type of the values
+	std::vector<VarDocument::BinaryValue> binaryValues;
+	for( const auto& value : doc->getValues() ) {
+		const auto var = mRegistry.find( value.group, value.name );
+		if( ! var || ( ! value.text.empty() && value.text.front() == '=' ) )
+			continue;
+
+		VarDocument::BinaryValue binaryValue{ &value, var->getType(), {} };
+		try {
+			if( binaryValue.type != VarType::Unknown && var->encodeBinary( value, &binaryValue.data ) )
+				binaryValues.push_back( std::move( binaryValue ) );
+		}
+		catch( const JsonTree::ExcJsonParserError& ) {
+			// already reported by the load, keeps the text form
+		}
+	}
+
+	post( [doc, binaryValues] {
+		if( ! doc->writeSnapshot( binaryValues ) )
+			CI_LOG_W( "Failed to write the snapshot of " + doc->getSourcePath().string() );
+	} );
+}
+
+bool JsonBag::post( const std::function<void()>& job )
+{
+	{
+		std::lock_guard<std::mutex> lock( mWorkerThreadMutex );
+		if( ! mWorkerThread )
+			mWorkerThread.reset( new std::thread( &JsonBag::workerThreadFn, this ) );
+	}
+
+	if( ! mWorkerJobs.tryPushFront( job ) ) {
+		CI_LOG_W( "Too many pending jobs, dropping one." );
+		return false;
+	}
+	return true;
+}
+
+void JsonBag::loadAsync( const fs::path & path )
+{
+	mIsLoaded = false;
+	// the file is read when the job runs, so that a burst of loads reads its latest content
+	const bool posted = post( [this, path] {
+		if( ! skipOwnWrite( path ) )
+			mParsedDocuments.pushFront( { path, read( path ) } );
+	} );
+	if( ! posted ) {
+		// never parsed on the calling thread: started again by update() like a scheduled reload, without its quiet window
+		CI_LOG_W( "Failed to queue the load of " + path.string() + ", retrying it with the next update." );
+		std::lock_guard<std::mutex> lock( mReloadMutex );
+		auto& reload = mScheduledReloads[path];
+		if( ! reload.pending ) {
+			reload.retries = 0;
+			reload.pending = true;
+			reload.notified = false;
+		}
+		reload.dueTime = std::chrono::steady_clock::now();
+	}
+}
+
+void JsonBag::setGroupTransition( const std::string& groupName, float duration, VarEaseFn easing )
+{
+	std::lock_guard<std::mutex> lock( mItemsMutex );
+	mGroupTransitions[groupName] = { duration, easing };
+}
+
+namespace
+{
+	// number of floats of the values that can transition
+	size_t getTransitionComponents(VarType type)
+	{
+		switch(type)
+		{
+			case VarType::Float:	return 1;
+			case VarType::Vec2:		return 2;
+			case VarType::Vec3:		return 3;
+			case VarType::Vec4:		return 4;
+			case VarType::Color:	return 3;
+			default:				return 0;
+		}
+	}
+}
+
+bool JsonBag::startTransition( VarBase* var, const VarDocument::Value& value )
+{
+	// called with mItemsMutex held
+	if( mTransitions.empty() ) // the first step starts from now
+		mLastTransitionsUpdate = std::chrono::steady_clock::now();
+	const size_t components = getTransitionComponents( var->getType() );
+	if( ! components )
+		return false;
+
+	float duration = var->mTransitionDuration;
+	VarEaseFn easing = var->mTransitionEasing;
+	if( duration < 0.0f ) {
+		auto groupIt = mGroupTransitions.find( var->getGroupName() );
+		if( groupIt == mGroupTransitions.end() )
+			return false;
+		duration = groupIt->second.first;
+		easing = groupIt->second.second;
+	}
+	if( duration <= 0.0f )
+		return false;
+
+	std::vector<char> end;
+	if( value.binaryType == var->getType() )
+		end.assign( value.binary.begin(), value.binary.end() );
+	else if( ! var->encodeBinary( value, &end ) )
+		return false;
+	if( end.size() != components * sizeof( float ) )
+		return false;
+
+	mTransitions.start( var, &var->mTransitionIndex, static_cast<float*>( var->getTarget() ), components, reinterpret_cast<const float*>( end.data() ), duration, easing );
+	return true;
+}
+
+void JsonBag::updateTransitions()
+{
+	// notified together once the step is done, like a load
+	beginTransaction();
+	{
+		ValueWriteLock lock{ mItemsMutex, this };
+		const auto now = std::chrono::steady_clock::now();
+		const float elapsed = std::chrono::duration<float>( now - mLastTransitionsUpdate ).count();
+		mLastTransitionsUpdate = now;
+		mTransitions.step( elapsed, [] ( VarBase* var ) { var->valueWritten(); } );
+	}
+	endTransaction();
+}
+
+void JsonBag::scheduleReload( const fs::path & path )
+{
+	// each file has its own quiet window: a burst of events on one file does not delay the others
+	std::lock_guard<std::mutex> lock( mReloadMutex );
+	auto& reload = mScheduledReloads[path];
+	reload.dueTime = std::chrono::steady_clock::now() + mReloadQuietWindow;
+	reload.retries = 0;
+	reload.pending = true;
+	reload.notified = true;
+}
+
+void JsonBag::setReloadQuietWindow( double seconds )
+{
+	std::lock_guard<std::mutex> lock( mReloadMutex );
+	mReloadQuietWindow = std::chrono::duration_cast<std::chrono::steady_clock::duration>( std::chrono::duration<double>( seconds ) );
+}
+
+double JsonBag::getReloadQuietWindow() const
+{
+	std::lock_guard<std::mutex> lock( mReloadMutex );
+	return std::chrono::duration<double>( mReloadQuietWindow ).count();
+}
+
+void JsonBag::startScheduledReload()
+{
+	std::vector<std::pair<fs::path, ScheduledReload>> due;
+	{
+		std::lock_guard<std::mutex> lock( mReloadMutex );
+		const auto now = std::chrono::steady_clock::now();
+		for( auto& reloadKv : mScheduledReloads ) {
+			auto& reload = reloadKv.second;
+			// a single load of a file at a time: changes made meanwhile are picked up by the next one
+			if( ! reload.pending || reload.running || now < reload.dueTime )
+				continue;
+			reload.pending = false;
+			reload.running = true;
+			due.emplace_back( reloadKv.first, reload );
+		}
+	}
+
+	for( const auto& reloadKv : due ) {
+		const fs::path path = reloadKv.first;
+		const int retries = reloadKv.second.retries;
+		const bool notified = reloadKv.second.notified;
+		mIsLoaded = false;
+		const bool posted = post( [this, path, retries, notified] {
+			ParsedDocument parsed{ path, nullptr, notified };
+			std::string error;
+			const bool skipped = skipOwnWrite( path );
+			if( ! skipped )
+				parsed.doc = read( path, &error );
+
+			{
+				std::lock_guard<std::mutex> lock( mReloadMutex );
+				auto reloadIt = mScheduledReloads.find( path );
+				auto& reload = reloadIt->second;
+				reload.running = false;
+				if( ! error.empty() && ! reload.pending ) {
+					if( retries < MAX_RELOAD_RETRIES ) {
+						// most likely caught while being written: try again once it is quiet
+						CI_LOG_W( "Failed to parse " + path.string() + ", retrying.\n" + error );
+						reload.dueTime = std::chrono::steady_clock::now() + mReloadQuietWindow;
+						reload.retries = retries + 1;
+						reload.pending = true;
+						return;
+					}
+					CI_LOG_E( "Failed to parse json file.\n" + error );
+				}
+				if( ! reload.pending )
+					mScheduledReloads.erase( reloadIt );
+			}
+
+			if( ! skipped )
+				mParsedDocuments.pushFront( parsed );
+		} );
+
+		if( ! posted ) {
+			std::lock_guard<std::mutex> lock( mReloadMutex );
+			auto& reload = mScheduledReloads[path];
+			reload.running = false;
+			if( ! reload.pending ) {
+				reload.pending = true;
+				reload.retries = retries;
+				reload.notified = notified;
+			}
+		}
+	}
+}
+
+std::vector<VarBase*> JsonBag::update()
+{
+	CI_ASSERT( ci::app::isMainThread() );
+
+	startScheduledReload();
+	updateTransitions();
+	// before the documents read since, which compare their values to the saved ones
+	if( ! mPendingApply )
+		updateLoadedHashes();
+
+	// in the order they were read: documents of different files, e.g. shards, hold different groups
+	std::vector<VarBase*> changedVars;
+	size_t budget = mMaxVarsPerUpdate ? mMaxVarsPerUpdate.load() : std::numeric_limits<size_t>::max();
+	for( ;; ) {
+		if( ! mPendingApply ) {
+			ParsedDocument parsed;
+			if( ! mParsedDocuments.tryPopBack( &parsed ) )
+				break;
+			mPendingApply = beginApply( parsed.path, parsed.doc, parsed.notified );
+			if( ! mPendingApply )
+				continue;
+		}
+		// continued by the next frame once the budget is spent
+		if( ! applyValues( mPendingApply.get(), &budget, &changedVars ) )
+			break;
+		finishApply( mPendingApply.get() );
+		mPendingApply.reset();
+	}
+	if( mReplay ) {
+		const auto replayChangedVars = updateReplay();
+		changedVars.insert( changedVars.end(), replayChangedVars.begin(), replayChangedVars.end() );
+	}
+	if( ! mSharedMemoryName.empty() ) {
+		const auto sharedChangedVars = updateSharedMemory();
+		changedVars.insert( changedVars.end(), sharedChangedVars.begin(), sharedChangedVars.end() );
+	}
+	if( mSocketServer ) {
+		// after the document, a value set live wins over the same frame's reload
+		const auto socketChangedVars = handleSocketRequests();
+		changedVars.insert( changedVars.end(), socketChangedVars.begin(), socketChangedVars.end() );
+	}
+
+	if( mRecording ) {
+		std::lock_guard<std::mutex> lock( mRecordMutex );
+		if( mRecordFile && mRecordFramePending ) {
+			const auto time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - mRecordStartTime ).count();
+			VarLog::appendRecord( &mRecordBuffer, VarLog::Kind::Frame, VarType::Unknown, 0, time );
+			mRecordFramePending = false;
+		}
+	}
+	return changedVars;
 }
 
-JsonBag::JsonBag()
-: mVersion{ 0 }
-, mIsLoaded{ false }
+bool JsonBag::startRecording( const fs::path& path )
 {
+	stopRecording();
+	auto file = std::make_shared<std::ofstream>( path, std::ios::binary | std::ios::trunc );
+	if( ! *file ) {
+		CI_LOG_E( "Failed to create " + path.string() );
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock( mRecordMutex );
+	mRecordFile = file;
+	mRecordBuffer.clear();
+	mRecordBuffer.reserve( RECORD_FLUSH_SIZE + 256 );
+	VarLog::appendHeader( &mRecordBuffer );
+	mRecordHandles.clear();
+	mNextRecordHandle = 0;
+	mRecordStartTime = std::chrono::steady_clock::now();
+	mRecordFramePending = false;
+	mRecording = true;
+	return true;
 }
 
-void JsonBag::setFilepath( const fs::path & filepath )
+void JsonBag::stopRecording()
 {
-	std::lock_guard<std::mutex> lock( mPathMutex );
-	mJsonFilePath = filepath;
+	std::lock_guard<std::mutex> lock( mRecordMutex );
+	if( ! mRecordFile )
+		return;
+
+	mRecording = false;
+	flushRecording();
+	// closed by the worker once the pending chunks are written
+	auto file = std::move( mRecordFile );
+	if( ! post( [file] { file->close(); } ) )
+		file->close();
+	mRecordHandles.clear();
 }
 
-const fs::path & cinder::JsonBag::getFilepath() const
+void JsonBag::record( const VarBase* var )
 {
-	std::lock_guard<std::mutex> lock( mPathMutex );
-	return mJsonFilePath;
+	std::lock_guard<std::mutex> lock( mRecordMutex );
+	if( ! mRecordFile || var->getType() == VarType::Unknown || var->getType() == VarType::Dynamic )
+		return;
+
+	const auto time = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - mRecordStartTime ).count();
+	auto handleIt = mRecordHandles.find( var );
+	if( handleIt == mRecordHandles.end() ) {
+		// replayed by name, in any session
+		const std::string name = var->getGroupName() + '.' + var->getName();
+		handleIt = mRecordHandles.emplace( var, mNextRecordHandle++ ).first;
+		VarLog::appendRecord( &mRecordBuffer, VarLog::Kind::Define, var->getType(), handleIt->second, time, name.data(), static_cast<uint32_t>( name.size() ) );
+	}
+
+	// the value is appended in place, without an intermediate copy
+	const size_t recordStart = mRecordBuffer.size();
+	const size_t sizeOffset = VarLog::appendRecord( &mRecordBuffer, VarLog::Kind::Value, var->getType(), handleIt->second, time );
+	if( ! var->saveBinary( &mRecordBuffer ) ) {
+		mRecordBuffer.resize( recordStart );
+		return;
+	}
+	VarLog::setSize( &mRecordBuffer, sizeOffset, static_cast<uint32_t>( mRecordBuffer.size() - sizeOffset - sizeof( uint32_t ) ) );
+	mRecordFramePending = true;
+
+	if( mRecordBuffer.size() >= RECORD_FLUSH_SIZE )
+		flushRecording();
 }
 
-void cinder::JsonBag::addDynamicVarContainer(std::string name, IDynamicVarContainer * container)
+void JsonBag::markShared( VarBase* var )
 {
-	std::lock_guard<std::mutex> lock( mFactoryProviderMutex );
-	mDynamicVarContainers.emplace(std::move(name), container);
+	std::lock_guard<std::mutex> lock( mSharedMutex );
+	mSharedChangedVars.insert( var );
 }
 
-namespace
+void JsonBag::forgetRecordedVar( const VarBase* var )
 {
-	bool splitName(const std::string & name, std::string * group, std::string * var, char separator = '.')
-	{
-		const auto index = name.find(separator);
-		if(index == std::string::npos)
-		{
-			return false;
-		}
-		*group = name.substr(0, index);
-		*var = name.substr(index+1);
-		return true;
+	// a new var at the same address gets its own handle
+	if( mRecording ) {
+		std::lock_guard<std::mutex> lock( mRecordMutex );
+		mRecordHandles.erase( var );
 	}
 }
 
-VarBase * JsonBag::findVar(const std::string & fullName) const
+void JsonBag::flushRecording()
 {
-	std::string groupName, varName;
-	if(!splitName(fullName, &groupName, &varName))
-	{
-		CI_LOG_E("cannot parse \"" + fullName + "\". Must be \"group.varName\"");
-		return nullptr;
-	}
+	// called with mRecordMutex held
+	if( mRecordBuffer.empty() )
+		return;
 
-	const auto & items = ci::bag().getItems();
-	const auto groupIt = items.find(groupName);
-	if(groupIt == items.end())
-	{
-		CI_LOG_W("group \"" + groupName + "\" not found");
-		return nullptr;
-	}
+	auto chunk = std::make_shared<std::vector<char>>();
+	chunk->reserve( RECORD_FLUSH_SIZE + 256 );
+	std::swap( *chunk, mRecordBuffer );
+	auto file = mRecordFile;
+	const auto job = [file, chunk] {
+		if( ! file->write( chunk->data(), chunk->size() ) )
+			CI_LOG_E( "Failed to write the recording" );
+	};
+	// kept for the next flush when the worker is busy
+	if( ! post( job ) )
+		std::swap( *chunk, mRecordBuffer );
+}
 
-	const auto varIt = groupIt->second.find(varName);
-	if(varIt == groupIt->second.end())
-	{
-		CI_LOG_W("var \"" + varName + "\" not found in group \"" + groupName + "\"");
-		return nullptr;
+bool JsonBag::startReplay( const fs::path& path, bool originalSpeed )
+{
+	CI_ASSERT( ci::app::isMainThread() );
+	mReplay = VarLog::Reader::open( path );
+	if( ! mReplay ) {
+		CI_LOG_E( "Failed to read the recording " + path.string() );
+		return false;
 	}
+	mReplayOriginalSpeed = originalSpeed;
+	mReplayStartTime = std::chrono::steady_clock::now();
+	mReplayNames.clear();
+	mReplayVars.clear();
+	mReplayVarsGeneration = ~uint64_t( 0 );
+	return true;
+}
 
-	return varIt->second;
+void JsonBag::stopReplay()
+{
+	mReplay.reset();
+	mReplayNames.clear();
+	mReplayVars.clear();
 }
 
-bool JsonBag::findVarName(const VarBase * var, std::string *name, std::string *groupName) const
+std::vector<VarBase*> JsonBag::updateReplay()
 {
-	for(const auto & groups : ci::bag().getItems())
-	{
-		for(const auto & vars : groups.second)
-		{
-			if(vars.second == var)
-			{
-				if(groupName)
-				{
-					*groupName = groups.first;
-				}
-				if(name)
-				{
-					*name = vars.first;
+	const auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>( std::chrono::steady_clock::now() - mReplayStartTime ).count();
+
+	std::vector<VarBase*> changedVars;
+	beginTransaction();
+	ValueWriteLock lock{ mItemsMutex, this };
+	if( mReplayVarsGeneration != mRegistryGeneration ) {
+		for( size_t i = 0; i < mReplayNames.size(); ++i )
+			mReplayVars[i] = findVarLocked( mReplayNames[i] );
+		mReplayVarsGeneration = mRegistryGeneration;
+	}
+
+	while( const auto record = mReplay->peek() ) {
+		if( mReplayOriginalSpeed && record->time > uint64_t( elapsed ) )
+			break;
+
+		if( record->kind == VarLog::Kind::Define ) {
+			if( record->handle >= mReplayNames.size() ) {
+				mReplayNames.resize( record->handle + 1 );
+				mReplayVars.resize( record->handle + 1, nullptr );
+			}
+			mReplayNames[record->handle] = std::string{ record->data };
+			mReplayVars[record->handle] = findVarLocked( record->data );
+		}
+		else if( record->kind == VarLog::Kind::Value && record->handle < mReplayVars.size() ) {
+			VarBase* var = mReplayVars[record->handle];
+			if( var && var->getType() == record->type ) {
+				mTransitions.cancel( &var->mTransitionIndex );
+				if( var->loadBinary( record->data ) ) {
+					detachFromFile( var );
+					changedVars.push_back( var );
 				}
-				return true;
 			}
 		}
+		const bool endOfFrame = record->kind == VarLog::Kind::Frame;
+		mReplay->pop();
+		if( endOfFrame && ! mReplayOriginalSpeed )
+			break;
 	}
-	return false;
+
+	if( ! mReplay->peek() ) {
+		CI_LOG_I( "Replay finished" );
+		mReplay.reset();
+	}
+	lock.unlock();
+	endTransaction();
+	return changedVars;
 }
 
-void JsonBag::emplace( VarBase* var, const std::string &name, const std::string groupName )
+bool JsonBag::listen( const fs::path& socketPath, int mode )
 {
-	std::lock_guard<std::mutex> lock( mItemsMutex );
+	CI_ASSERT( ci::app::isMainThread() );
+	stopListening();
+	mSocketServer = VarSocketServer::open( socketPath, mode );
+	return mSocketServer != nullptr;
+}
 
-	if( mItems[groupName].count( name ) ) {
-		CI_LOG_E( "Bag already contains '" + name + "' in group '" + groupName + "', not adding." );
-		return;
-	}
-	
-	mItems[groupName].emplace( name, var );
-	var->setOwner( this );
+void JsonBag::stopListening()
+{
+	mSubscriptions.clear();
+	mSocketServer.reset();
 }
 
-void JsonBag::removeTarget( void *target )
+bool JsonBag::publishSharedMemory( const std::string& name, int mode )
 {
-	if( ! target )
-		return;
-	
-	std::lock_guard<std::mutex> lock( mItemsMutex );
+	CI_ASSERT( ci::app::isMainThread() );
+	closeSharedMemory();
+	mSharedMemoryName = name;
+	mSharedMemoryMode = mode;
+	mSharedMemoryWriter = true;
+	updateSharedMemory();
+	return mSharedMemory != nullptr;
+}
 
-	for( auto& kv : mItems ) {
-		const auto& groupName = kv.first;
-		auto& group = kv.second;
-		
-		for( auto it = group.cbegin(); it != group.cend(); ++it ) {
-			if( it->second->getTarget() == target ) {
-				
-				group.erase( it );
-				
-				if( group.empty() )
-					mItems.erase( groupName );
-				
-				return;
-			}
-		}
-	}
-	CI_LOG_E( "Target not found." );
+void JsonBag::subscribeSharedMemory( const std::string& name )
+{
+	CI_ASSERT( ci::app::isMainThread() );
+	closeSharedMemory();
+	mSharedMemoryName = name;
+	mSharedMemoryWriter = false;
 }
 
-void JsonBag::save() const
+void JsonBag::closeSharedMemory()
 {
-	fs::path p;
+	mSharedMemoryWriter = false;
+	mSharedMemory.reset();
+	mSharedMemoryName.clear();
+	mSharedEntries.clear();
 	{
-		std::lock_guard<std::mutex> lock( mPathMutex );
-		CI_ASSERT( fs::is_regular_file( mJsonFilePath ) );
-		p = mJsonFilePath;
+		std::lock_guard<std::mutex> lock( mSharedMutex );
+		mSharedChangedVars.clear();
 	}
-	save( p );
+	mSharedVars.clear();
+	mSharedSequences.clear();
+	// laid out again by the next update
+	mSharedVarsGeneration = ~uint64_t( 0 );
 }
 
-void JsonBag::save( const fs::path& path ) const
+std::vector<VarBase*> JsonBag::updateSharedMemory()
 {
-	JsonTree doc;
-
-	{
-		std::lock_guard<std::mutex> lock(mFactoryProviderMutex);
-		if(!mDynamicVarContainers.empty())
+	if( mSharedMemoryWriter ) {
+		std::lock_guard<std::mutex> lock( mItemsMutex );
+		std::unordered_set<const VarBase*> changedVars;
 		{
-			JsonTree root = JsonTree::makeObject(DYNAMIC_OBJECTS_TAG);
-			for(const auto & item : mDynamicVarContainers)
-			{
-				const auto & name = item.first;
-				const auto & container = item.second;
-				JsonTree objectList = JsonTree::makeObject(name);
+			std::lock_guard<std::mutex> sharedLock( mSharedMutex );
+			std::swap( changedVars, mSharedChangedVars );
+		}
 
-				for(const auto& item : container->getContentForSave())
-				{
-					objectList.addChild(JsonTree{ item.name, item.typeParams });
+		if( mSharedVarsGeneration != mRegistryGeneration ) {
+			// laid out from the registered vars, again when they change
+			std::vector<VarSharedMemory::Item> items;
+			mSharedEntries.clear();
+			for( const auto& group : mItems ) {
+				for( const auto& item : group.second ) {
+					VarBase* var = item.second;
+					mSharedValue.clear();
+					if( var->getType() < VarType::Bool || var->getType() > VarType::Color || ! var->saveBinary( &mSharedValue ) )
+						continue;
+					mSharedEntries.emplace( var, items.size() );
+					items.push_back( { VarRegistry::hash( group.first, item.first ), var->getType(), static_cast<uint32_t>( mSharedValue.size() ) } );
 				}
-				root.addChild(objectList);
 			}
-			doc.addChild(root);
+			mSharedVarsGeneration = mRegistryGeneration;
+			mSharedMemory = VarSharedMemory::create( mSharedMemoryName, items, mSharedMemoryMode );
+			if( ! mSharedMemory )
+				mSharedEntries.clear();
+
+			// every value once, the new object is zero-filled
+			changedVars.clear();
+			for( const auto& entry : mSharedEntries )
+				changedVars.insert( entry.first );
+		}
+
+		// only the vars written since the last update, as seen by VarBase::callUpdateFn()
+		for( const VarBase* var : changedVars ) {
+			auto entryIt = mSharedEntries.find( var );
+			if( entryIt == mSharedEntries.end() )
+				continue;
+			mSharedValue.clear();
+			if( var->saveBinary( &mSharedValue ) )
+				mSharedMemory->write( entryIt->second, mSharedValue.data() );
 		}
+		return {};
 	}
 
-	for( const auto& group : mItems ) {
-		JsonTree jsonGroup = JsonTree::makeArray( group.first );
-		for( const auto& item : group.second ) {
-            if(auto input = item.second->getConnectedInput())
-            {
-                std::string groupName, varName;
-                const bool found = findVarName(input, &varName, &groupName);
-                assert(found);
-                const auto inputName = groupName.empty() ? varName : (groupName + '.' + varName);
-            	jsonGroup.addChild(ci::JsonTree(item.first, "=" + inputName));
-            }
-            else
-            {
-			    item.second->save( item.first, &jsonGroup );
-            }
+	bool remap = false;
+	if( ! mSharedMemory || mSharedMemory->isStale() ) {
+		mSharedMemory = VarSharedMemory::open( mSharedMemoryName );
+		remap = true;
+	}
+	if( ! mSharedMemory )
+		return {};
+
+	std::vector<VarBase*> changedVars;
+	beginTransaction();
+	ValueWriteLock lock{ mItemsMutex, this };
+	if( remap || mSharedVarsGeneration != mRegistryGeneration ) {
+		mSharedVars.clear();
+		for( const auto& group : mItems ) {
+			for( const auto& item : group.second ) {
+				const int index = mSharedMemory->findEntry( VarRegistry::hash( group.first, item.first ), item.second->getType() );
+				if( index >= 0 )
+					mSharedVars.emplace_back( item.second, index );
+			}
 		}
-		doc.pushBack( jsonGroup );
+		mSharedSequences.assign( mSharedVars.size(), 0 );
+		mSharedVarsGeneration = mRegistryGeneration;
 	}
 
-	doc.addChild( JsonTree{ "version", mVersion } );
-	doc.write( writeFile( path ), JsonTree::WriteOptions() );
+	for( size_t i = 0; i < mSharedVars.size(); ++i ) {
+		VarBase* var = mSharedVars[i].first;
+		if( ! mSharedMemory->read( mSharedVars[i].second, &mSharedSequences[i], &mSharedValue ) )
+			continue;
+		mTransitions.cancel( &var->mTransitionIndex );
+		if( var->loadBinary( { mSharedValue.data(), mSharedValue.size() } ) ) {
+			detachFromFile( var );
+			changedVars.push_back( var );
+		}
+	}
+	lock.unlock();
+	endTransaction();
+	return changedVars;
 }
 
-void JsonBag::load( const fs::path & path )
+std::vector<VarBase*> JsonBag::handleSocketRequests()
 {
-	{
-		std::lock_guard<std::mutex> lock( mPathMutex );
-		mJsonFilePath = path;
+	const auto requests = mSocketServer->takeRequests();
+	if( requests.empty() )
+		return {};
+
+	// notified once, after all the requests of the frame
+	std::vector<VarBase*> changedVars;
+	beginTransaction();
+	for( const auto& request : requests ) {
+		if( request.closed ) {
+			mSubscriptions.erase( mSubscriptions.lower_bound( { request.client, std::string{} } ), mSubscriptions.lower_bound( { request.client + 1, std::string{} } ) );
+			continue;
+		}
+
+		// <command> <group.name> [<value>]
+		const auto& line = request.line;
+		const size_t commandEnd = std::min( line.find( ' ' ), line.size() );
+		const size_t nameBegin = std::min( line.find_first_not_of( ' ', commandEnd ), line.size() );
+		const size_t nameEnd = std::min( line.find( ' ', nameBegin ), line.size() );
+		const std::string command = line.substr( 0, commandEnd );
+		const std::string name = line.substr( nameBegin, nameEnd - nameBegin );
+		const std::string value = line.substr( std::min( nameEnd + 1, line.size() ) );
+
+		const std::string error = handleSocketRequest( request.client, command, name, value, &changedVars );
+		if( ! error.empty() )
+			mSocketServer->send( request.client, "error " + error );
 	}
+	endTransaction();
+	return changedVars;
+}
 
-	if( ! fs::exists( path ) )
-		return;
+std::string JsonBag::handleSocketRequest( uint64_t client, const std::string& command, const std::string& name, const std::string& value, std::vector<VarBase*>* changedVars )
+{
+	if( command == "unsubscribe" ) {
+		mSubscriptions.erase( { client, name } );
+		return {};
+	}
 
-	try {
-		JsonTree doc( loadFile( path ) );
+	VarBase* var = findVar( name );
+	if( ! var )
+		return "no var named " + name;
 
-		if( doc.hasChild( "version" ) ) {
-			mVersion = doc.getChild( "version" ).getValue<int>();
+	if( command == "get" ) {
+		sendValue( client, var );
+	}
+	else if( command == "subscribe" ) {
+		auto& connection = mSubscriptions[{ client, name }];
+		if( ! connection.isConnected() )
+			connection = var->addUpdateFn( [this, client, var] { sendValue( client, var ); } );
+		sendValue( client, var );
+	}
+	else if( command == "set" ) {
+		// parsed as the value of a var file, to load it like one
+		const std::string text = "{\"v\":{\"v\":" + value + "}}";
+		std::unique_ptr<VarDocument> doc;
+		try {
+			doc = VarDocument::parse( std::vector<char>( text.begin(), text.end() ) );
+		}
+		catch( const JsonTree::ExcJsonParserError& exc ) {
+			return "invalid value for " + name + ". " + exc.what();
 		}
+		const auto docValue = doc->find( "v", "v" );
+		if( ! docValue || value.empty() )
+			return "invalid value for " + name;
+
+		ValueWriteLock lock{ mItemsMutex, this };
+		detachFromFile( var );
+		var->disconnect();
+		mTransitions.cancel( &var->mTransitionIndex );
+		try {
+			var->load( *docValue );
+		}
+		catch( const JsonTree::ExcJsonParserError& exc ) {
+			return "invalid value for " + name + ". " + exc.what();
+		}
+		// once per var, however many times the frame's requests set it
+		if( lock.getWrites() && std::find( changedVars->begin(), changedVars->end(), var ) == changedVars->end() )
+			changedVars->push_back( var );
+	}
+	else
+		return "unknown command " + command;
 
-		if(doc.hasChild(DYNAMIC_OBJECTS_TAG))
-		{
-			CI_ASSERT_MSG(ci::app::isMainThread(), "Dynamic objects do not support async load");
+	return {};
+}
 
-			std::lock_guard<std::mutex> lock(mFactoryProviderMutex);
-			if(!mDynamicVarContainers.empty())
-			{
-				std::vector<IDynamicVarContainer *> toClear;
-				toClear.reserve(mDynamicVarContainers.size());
-				for(const auto & item : mDynamicVarContainers)
-				{
-					toClear.push_back(item.second);
-				}
+void JsonBag::sendValue( uint64_t client, const VarBase* var )
+{
+	// formatted like in the var files, on a single line
+	JsonTree tree = JsonTree::makeArray( var->getGroupName() );
+	var->save( var->getName(), &tree );
+	if( tree.getChildren().empty() || ! mSocketServer )
+		return;
 
-				for(const auto & dynamic : doc.getChild(DYNAMIC_OBJECTS_TAG))
-				{
-					const auto & dynamicName = dynamic.getKey();
+	std::string text = tree.getChildren().front().serialize();
+	text.erase( std::remove_if( text.begin(), text.end(), [] ( char c ) { return c == '\n' || c == '\r' || c == '\t'; } ), text.end() );
+	mSocketServer->send( client, var->getGroupName() + '.' + var->getName() + ' ' + text );
+}
 
-					const auto & dynamicIt = mDynamicVarContainers.find(dynamicName);
-					//const auto & factory = mFactoryProvider->get(factoryName);
-					if(dynamicIt == mDynamicVarContainers.end())
-					{
-						CI_LOG_E( "No dynamic var container for " + dynamicName );
-						continue;
-					}
-					const auto & container = dynamicIt->second;
-
-					std::vector<IDynamicVarContainer::TypeAndName> content;
-					for(const auto & item : dynamic.getChildren())
-					{
-						const auto & name = item.getKey();
-						const auto& typeName = item.getValue();
-						content.push_back({typeName, name});
-					}
-					container->loadContent(content);
+void JsonBag::workerThreadFn()
+{
+	ci::ThreadSetup threadSetup;
+	for( ;; ) {
+		std::function<void()> job;
+		mWorkerJobs.popBack( &job );
+		// an empty job stops the thread
+		if( ! job )
+			break;
+
+		job();
+	}
+}
 
-					const auto toClearIt = std::find(toClear.begin(), toClear.end(), container);
-					if(toClearIt != toClear.end())
-					{
-						toClear.erase(toClearIt);
-					}
-				}
+void JsonBag::postSave( const std::function<void()>& job )
+{
+	{
+		std::lock_guard<std::mutex> lock( mSaveMutex );
+		if( ! mSaveThread )
+			mSaveThread.reset( new std::thread( &JsonBag::saveThreadFn, this ) );
+		mSaveJobs.push_back( job );
+	}
+	mSaveCondition.notify_one();
+}
 
-				// clear unreferenced containers
-				for(const auto & container : toClear)
-				{
-					container->loadContent({});
-				}
-			}
-			else
-			{
-				CI_LOG_E( "No dynamic var container provided" );
-			}
+void JsonBag::saveThreadFn()
+{
+	ci::ThreadSetup threadSetup;
+	for( ;; ) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock( mSaveMutex );
+			mSaveCondition.wait( lock, [this] { return ! mSaveJobs.empty(); } );
+			job = std::move( mSaveJobs.front() );
+			mSaveJobs.pop_front();
 		}
+		// an empty job stops the thread
+		if( ! job )
+			break;
 
-		std::lock_guard<std::mutex> lock{ mItemsMutex };
-		for( auto& groupKv : mItems ) {
-			std::string groupName = groupKv.first;
-			if( doc.hasChild( groupName ) ) {
-				auto groupJson = doc.getChild( groupName );
-				for( auto& valueKv : groupKv.second ) {
-					std::string valueName = valueKv.first;
-					if( groupJson.hasChild( valueName ) ) {
-						auto tree = groupJson.getChild( valueKv.first );
-
-                        valueKv.second->disconnect();
-
-                        const auto & value = tree.getValue();
-                        if(!value.empty() && value.front() == '=')  // is connection
-                        {
-                            const auto & varName = value.substr(1);
-                            const auto inputVar = findVar(varName);
-                            if(!inputVar)
-                            {
-                                CI_LOG_E(varName + " not found. Connection failed.");
-                            }
-                            else if(!valueKv.second->tryConnectFrom(inputVar))
-                            {
-                                CI_LOG_E(varName + " and " + groupName + "." + varName + " are not compatible. Connection failed.");
-                            }
-                        }
-                        else  // load value
-                        {
-						    valueKv.second->load( tree );
-                        }
-					}
-					else {
-						CI_LOG_I( "No item named " + valueName + ": restore default value" );
-						valueKv.second->restoreDefault();
-					}
-				}
-			}
-			else {
-				CI_LOG_E( "No group named " + groupName );
-			}
-		}
+		job();
 	}
-	catch( const JsonTree::ExcJsonParserError& exc )  {
-		CI_LOG_E( "Failed to parse json file.\n" + std::string(exc.what()) );
-	}
-	mIsLoaded = true;
 }
 
-void JsonBag::loadAsync( const fs::path & path )
+VarBase::VarBase( void *target )
+	: mConnectedInput( nullptr ), mVoidPtr( target ), mOwner( nullptr ), mLoadedHash( UNLOADED_VALUE_HASH ), mNotificationPending( false ), mTransitionDuration( -1.0f ), mTransitionEasing( nullptr ), mTransitionIndex( VarTransitions::NONE ), mRegistrySlot( VarRegistry::NO_SLOT )
 {
-	mIsLoaded = false;
-	auto func = std::bind( &JsonBag::load, this, std::placeholders::_1 );
-	std::async( std::launch::async, func, path );
+
 }
 
-VarBase::VarBase( void *target )
-	: mVoidPtr( target ), mOwner( nullptr )
+
+void VarBase::cancelTransition()
 {
+	// an explicit value replaces the one being animated. Never called with the items mutex held: the bag
+	// only assigns values through load(), loadBinary() and restoreDefault()
+	if( mOwner ) {
+		std::lock_guard<std::mutex> lock( mOwner->mItemsMutex );
+		mOwner->mTransitions.cancel( &mTransitionIndex );
+	}
+}
 
+const std::string& VarBase::getName() const
+{
+	static const std::string empty;
+	return mOwner ? mItemIt->first : empty;
 }
 
+const std::string& VarBase::getGroupName() const
+{
+	static const std::string empty;
+	return mOwner ? mGroupIt->first : empty;
+}
 
 VarBase::~VarBase()
 {
 	if( mOwner )
-		mOwner->removeTarget( mVoidPtr );
+		mOwner->remove( this );
 };
 
 ci::signals::Connection VarBase::addUpdateFn( const std::function<void()> &updateFn, bool call )
 {
+#ifdef VAR_PROFILE_LISTENERS
+	// wrapped first, so that the initial call is timed too
+	const auto listener = VarListenerProfiler::instance().wrap( this, mUpdateFn.getNumSlots(), updateFn );
+#else
+	const auto& listener = updateFn;
+#endif
 	if( call )
-		updateFn();
-	return mUpdateFn.connect(updateFn);
+		listener();
+	return mUpdateFn.connect( listener );
 }
 
 void VarBase::callUpdateFn()
 {
-	mUpdateFn.emit();
+	if( auto lock = ValueWriteLock::find( mOwner ) )
+		lock->addWrite();
+	else if( mOwner && ! mConnectedInput ) {
+		// a value that is not from a file, e.g. assigned or edited: the next load applies the file's value
+		// again. A connected var keeps the connection it was loaded with.
+		std::lock_guard<std::mutex> lock( mOwner->mItemsMutex );
+		mOwner->detachFromFile( this );
+	}
+
+	if( mOwner && mOwner->mRecording.load( std::memory_order_relaxed ) )
+		mOwner->record( this );
+	if( mOwner && mOwner->mSharedMemoryWriter.load( std::memory_order_relaxed ) )
+		mOwner->markShared( this );
+
+	if( mOwner && mOwner->mTransactionThread.load( std::memory_order_relaxed ) == std::this_thread::get_id() )
+		mOwner->deferNotification( this );
+	else if( mOwner && ! mConnectedOutputs.empty() ) {
+		// propagates to the connected vars in a single pass
+		mOwner->beginTransaction();
+		mOwner->deferNotification( this );
+		mOwner->endTransaction();
+	}
+	else
+		mUpdateFn.emit();
 }
 
 namespace
 {
-	ci::signals::Connection tryConnect(VarBase* input, VarBase* output)
+	// indexed by the (input, output) var types
+	struct ConnectionConverters
 	{
-		return {};
+		std::mutex mutex;
+		VarConverter table[VAR_TYPE_COUNT][VAR_TYPE_COUNT];
+
+		VarConverter & at(VarType from, VarType to)
+		{
+			return table[static_cast<size_t>(from)][static_cast<size_t>(to)];
+		}
+
+		template <class From, class To, class Convert>
+		void add(const Convert & convert)
+		{
+			at(VarTypeOf<From>::value, VarTypeOf<To>::value) = [convert] (const VarBase & input, VarBase * output)
+			{
+				output->setValue<To>(convert(input.getValue<From>()));
+			};
+		}
+
+		template <class ...Ts>
+		void addIdentities()
+		{
+			const auto identity = [] (const auto & value) { return value; };
+			(add<Ts, Ts>(identity), ...);
+		}
+
+		ConnectionConverters()
+		{
+			addIdentities<bool, int, float,
+				glm::ivec2, glm::ivec3, glm::ivec4,
+				glm::vec2, glm::vec3, glm::vec4,
+				glm::quat, ci::Color,
+				std::string, std::vector<int>, std::vector<float>>();
+
+			add<glm::ivec2, glm::vec2>([] (const glm::ivec2 & value) { return glm::vec2(value); });
+			add<glm::ivec3, glm::vec3>([] (const glm::ivec3 & value) { return glm::vec3(value); });
+			add<glm::ivec4, glm::vec4>([] (const glm::ivec4 & value) { return glm::vec4(value); });
+			add<float, glm::vec2>([] (float value) { return glm::vec2(value); });
+			add<float, glm::vec3>([] (float value) { return glm::vec3(value); });
+			add<float, glm::vec4>([] (float value) { return glm::vec4(value); });
+			add<ci::Color, glm::vec3>([] (const ci::Color & value) { return glm::vec3(value.r, value.g, value.b); });
+			add<glm::vec3, ci::Color>([] (const glm::vec3 & value) { return ci::Color(value.x, value.y, value.z); });
+
+			at(VarType::Dynamic, VarType::Dynamic) = [] (const VarBase & input, VarBase * output)
+			{
+				static_cast<DynamicVarBase*>(output)->setObjectName(static_cast<const DynamicVarBase&>(input).objectName());
+			};
+			at(VarType::Dynamic, VarType::String) = [] (const VarBase & input, VarBase * output)
+			{
+				output->setValue<std::string>(static_cast<const DynamicVarBase&>(input).objectName());
+			};
+			at(VarType::String, VarType::Dynamic) = [] (const VarBase & input, VarBase * output)
+			{
+				static_cast<DynamicVarBase*>(output)->setObjectName(input.getValue<std::string>());
+			};
+		}
+	};
+
+	ConnectionConverters & connectionConverters()
+	{
+		static ConnectionConverters converters;
+		return converters;
 	}
-	
-	template <class T, class ...Ts>
-    ci::signals::Connection tryConnect(VarBase * input, VarBase * output, const T& current, const Ts&... args)
-    {
-        if(auto typedInput = dynamic_cast<Var<T>*>(input))
-        {
-            if(auto typedOutput = dynamic_cast<Var<T>*>(output))
-            {
-                return input->addUpdateFn([typedInput, typedOutput]
-                {
-                    *typedOutput = typedInput->value();
-                }, true);
-            }
-        }
-        return tryConnect(input, output, args...);
-    }
+}
 
-    template <class ...Ts>
-    ci::signals::Connection tryConnect(VarBase * input, VarBase * output, DynamicVarBase * current, const Ts&... args)
-    {
-        auto dynamicInput = dynamic_cast<DynamicVarBase*>(input);
-        auto dynamicOutput = dynamic_cast<DynamicVarBase*>(output);
-        if(dynamicInput || dynamicOutput)
-        {
-            if(dynamicInput && dynamicOutput)
-            {
-                return input->addUpdateFn([dynamicInput, dynamicOutput]
-                {
-                    dynamicOutput->setObjectName(dynamicInput->objectName());
-                }, true);
-            }
-            if(dynamicInput)
-            {
-                if(auto stringOutput = dynamic_cast<Var<std::string>*>(output))
-                {
-                    return input->addUpdateFn([dynamicInput, stringOutput]
-                    {
-                        *stringOutput = dynamicInput->objectName();
-                    }, true);
-                }
-            }
-            else
-            {
-                if(auto stringInput = dynamic_cast<Var<std::string>*>(input))
-                {
-                    return input->addUpdateFn([stringInput, dynamicOutput]
-                    {
-                        dynamicOutput->setObjectName(stringInput->value());
-                    }, true);
-                }
-            }
-        }
-        return tryConnect(input, output, args...);
-    }
+void ci::setConnectionConverter(VarType from, VarType to, const VarConverter & converter)
+{
+	auto & converters = connectionConverters();
+	std::lock_guard<std::mutex> lock(converters.mutex);
+	converters.at(from, to) = converter;
+}
+
+VarConverter ci::findConnectionConverter(VarType from, VarType to)
+{
+	auto & converters = connectionConverters();
+	std::lock_guard<std::mutex> lock(converters.mutex);
+	return converters.at(from, to);
 }
 
 bool VarBase::tryConnectFrom(VarBase * input)
 {
-    mConnection = tryConnect(input, this,
-        static_cast<DynamicVarBase*>(nullptr),
-        bool{}, float{}, int{},
-        ci::vec2{}, ci::vec3{}, ci::vec4{},
-        ci::ivec2{}, ci::ivec3{}, ci::ivec4{},
-        std::string{},
-        std::vector<int>{}, std::vector<float>{}
-        );
+    disconnect();
+
+    // the bag orders the propagation of its own vars only
+    if(!input || !mOwner || input->mOwner != mOwner)
+    {
+        return false;
+    }
 
-    if(mConnection.isConnected())
+    for(auto upstream = input; upstream; upstream = upstream->mConnectedInput)
     {
-        mConnectedInput = input;
-        return true;
+        if(upstream == this)
+        {
+            CI_LOG_E("Connecting " + getGroupName() + "." + getName() + " to " + input->getGroupName() + "." + input->getName() + " would create a cycle.");
+            return false;
+        }
     }
-    else
+
+    const auto converter = findConnectionConverter(input->getType(), getType());
+    if(!converter)
     {
-        mConnectedInput = nullptr;
         return false;
     }
+    mPullInput = [converter, input, this]
+    {
+        converter(*input, this);
+    };
+
+    mConnectedInput = input;
+    input->mConnectedOutputs.push_back(this);
+    mOwner->mPropagationOrderDirty = true;
+    mPullInput();
+    return true;
 }
 
 void VarBase::disconnect()
 {
+    if(mConnectedInput)
+    {
+        auto & outputs = mConnectedInput->mConnectedOutputs;
+        outputs.erase(std::remove(outputs.begin(), outputs.end(), this), outputs.end());
+        if(mOwner)
+        {
+            mOwner->mPropagationOrderDirty = true;
+        }
+    }
     mConnectedInput = nullptr;
-    mConnection.disconnect();
+    mPullInput = nullptr;
+}
+
+void VarBase::disconnectOutputs()
+{
+    while(!mConnectedOutputs.empty())
+    {
+        mConnectedOutputs.back()->disconnect();
+    }
 }
 
 VarBase * VarBase::getConnectedInput() const
 {
-    return mConnection.isConnected() ? mConnectedInput : nullptr;
+    return mConnectedInput;
 }
 
 template<>
-void Var<bool>::save( const std::string& name, ci::JsonTree* tree ) const
+void Var<bool>::write( const bool& value, const std::string& name, ci::JsonTree* tree )
 {
-	tree->addChild( ci::JsonTree( name, ci::toString( mValue ) ) );
+	tree->addChild( ci::JsonTree( name, std::string( value ? "1" : "0" ) ) );
 }
 
 template<>
-void Var<int>::save( const std::string& name, ci::JsonTree* tree ) const
+void Var<int>::write( const int& value, const std::string& name, ci::JsonTree* tree )
 {
-	tree->addChild( ci::JsonTree( name, ci::toString( mValue ) ) );
+	tree->addChild( ci::JsonTree( name, formatNumber( value ) ) );
 }
 
 template<>
-void Var<float>::save( const std::string& name, ci::JsonTree* tree ) const
+void Var<float>::write( const float& value, const std::string& name, ci::JsonTree* tree )
 {
-	tree->addChild( ci::JsonTree( name, ci::toString( mValue ) ) );
+	tree->addChild( ci::JsonTree( name, formatNumber( value ) ) );
 }
 
 template<>
-void Var<glm::ivec2>::save(const std::string& name, ci::JsonTree* tree) const
+void Var<glm::ivec2>::write( const glm::ivec2& value, const std::string& name, ci::JsonTree* tree )
 {
 	auto v = ci::JsonTree::makeArray(name);
-	v.pushBack(ci::JsonTree("x", ci::toString(mValue.x)));
-	v.pushBack(ci::JsonTree("y", ci::toString(mValue.y)));
+	v.pushBack(ci::JsonTree("x", formatNumber(value.x)));
+	v.pushBack(ci::JsonTree("y", formatNumber(value.y)));
 	tree->addChild(v);
 }
 
 template<>
-void Var<glm::ivec3>::save(const std::string& name, ci::JsonTree* tree) const
+void Var<glm::ivec3>::write( const glm::ivec3& value, const std::string& name, ci::JsonTree* tree )
 {
 	auto v = ci::JsonTree::makeArray(name);
-	v.pushBack(ci::JsonTree("x", ci::toString(mValue.x)));
-	v.pushBack(ci::JsonTree("y", ci::toString(mValue.y)));
-	v.pushBack(ci::JsonTree("z", ci::toString(mValue.z)));
+	v.pushBack(ci::JsonTree("x", formatNumber(value.x)));
+	v.pushBack(ci::JsonTree("y", formatNumber(value.y)));
+	v.pushBack(ci::JsonTree("z", formatNumber(value.z)));
 	tree->addChild(v);
 }
 
 template<>
-void Var<glm::ivec4>::save(const std::string& name, ci::JsonTree* tree) const
+void Var<glm::ivec4>::write( const glm::ivec4& value, const std::string& name, ci::JsonTree* tree )
 {
 	auto v = ci::JsonTree::makeArray(name);
-	v.pushBack(ci::JsonTree("x", ci::toString(mValue.x)));
-	v.pushBack(ci::JsonTree("y", ci::toString(mValue.y)));
-	v.pushBack(ci::JsonTree("z", ci::toString(mValue.z)));
-	v.pushBack(ci::JsonTree("w", ci::toString(mValue.w)));
+	v.pushBack(ci::JsonTree("x", formatNumber(value.x)));
+	v.pushBack(ci::JsonTree("y", formatNumber(value.y)));
+	v.pushBack(ci::JsonTree("z", formatNumber(value.z)));
+	v.pushBack(ci::JsonTree("w", formatNumber(value.w)));
 	tree->addChild(v);
 }
 
 template<>
-void Var<glm::vec2>::save( const std::string& name, ci::JsonTree* tree ) const
+void Var<glm::vec2>::write( const glm::vec2& value, const std::string& name, ci::JsonTree* tree )
 {
 	auto v = ci::JsonTree::makeArray( name );
-	v.pushBack( ci::JsonTree( "x", ci::toString( mValue.x ) ) );
-	v.pushBack( ci::JsonTree( "y", ci::toString( mValue.y ) ) );
+	v.pushBack( ci::JsonTree( "x", formatNumber( value.x ) ) );
+	v.pushBack( ci::JsonTree( "y", formatNumber( value.y ) ) );
 	tree->addChild( v );
 }
 
 template<>
-void Var<glm::vec3>::save( const std::string& name, ci::JsonTree* tree ) const
+void Var<glm::vec3>::write( const glm::vec3& value, const std::string& name, ci::JsonTree* tree )
 {
 	auto v = ci::JsonTree::makeArray( name );
-	v.pushBack( ci::JsonTree( "x", ci::toString( mValue.x ) ) );
-	v.pushBack( ci::JsonTree( "y", ci::toString( mValue.y ) ) );
-	v.pushBack( ci::JsonTree( "z", ci::toString( mValue.z ) ) );
+	v.pushBack( ci::JsonTree( "x", formatNumber( value.x ) ) );
+	v.pushBack( ci::JsonTree( "y", formatNumber( value.y ) ) );
+	v.pushBack( ci::JsonTree( "z", formatNumber( value.z ) ) );
 	tree->addChild( v );
 }
 
 template<>
-void Var<glm::vec4>::save( const std::string& name, ci::JsonTree* tree ) const
+void Var<glm::vec4>::write( const glm::vec4& value, const std::string& name, ci::JsonTree* tree )
 {
 	auto v = ci::JsonTree::makeArray( name );
-	v.pushBack( ci::JsonTree( "x", ci::toString( mValue.x ) ) );
-	v.pushBack( ci::JsonTree( "y", ci::toString( mValue.y ) ) );
-	v.pushBack( ci::JsonTree( "z", ci::toString( mValue.z ) ) );
-	v.pushBack( ci::JsonTree( "w", ci::toString( mValue.w ) ) );
+	v.pushBack( ci::JsonTree( "x", formatNumber( value.x ) ) );
+	v.pushBack( ci::JsonTree( "y", formatNumber( value.y ) ) );
+	v.pushBack( ci::JsonTree( "z", formatNumber( value.z ) ) );
+	v.pushBack( ci::JsonTree( "w", formatNumber( value.w ) ) );
 	tree->addChild( v );
 }
 
 template<>
-void Var<glm::quat>::save( const std::string& name, ci::JsonTree* tree ) const
+void Var<glm::quat>::write( const glm::quat& value, const std::string& name, ci::JsonTree* tree )
 {
 	auto v = ci::JsonTree::makeArray( name );
-	v.pushBack( ci::JsonTree( "w", ci::toString( mValue.w ) ) );
-	v.pushBack( ci::JsonTree( "x", ci::toString( mValue.x ) ) );
-	v.pushBack( ci::JsonTree( "y", ci::toString( mValue.y ) ) );
-	v.pushBack( ci::JsonTree( "z", ci::toString( mValue.z ) ) );
+	v.pushBack( ci::JsonTree( "w", formatNumber( value.w ) ) );
+	v.pushBack( ci::JsonTree( "x", formatNumber( value.x ) ) );
+	v.pushBack( ci::JsonTree( "y", formatNumber( value.y ) ) );
+	v.pushBack( ci::JsonTree( "z", formatNumber( value.z ) ) );
 	tree->addChild( v );
 
 }
 
 template<>
-void Var<ci::Color>::save( const std::string& name, ci::JsonTree* tree ) const
+void Var<ci::Color>::write( const ci::Color& value, const std::string& name, ci::JsonTree* tree )
 {
 	auto v = ci::JsonTree::makeArray( name );
-	v.pushBack( ci::JsonTree( "r", ci::toString( mValue.r ) ) );
-	v.pushBack( ci::JsonTree( "g", ci::toString( mValue.g ) ) );
-	v.pushBack( ci::JsonTree( "b", ci::toString( mValue.b ) ) );
+	v.pushBack( ci::JsonTree( "r", formatNumber( value.r ) ) );
+	v.pushBack( ci::JsonTree( "g", formatNumber( value.g ) ) );
+	v.pushBack( ci::JsonTree( "b", formatNumber( value.b ) ) );
 	tree->addChild( v );
 }
 
 template<>
-void Var<std::string>::save( const std::string& name, ci::JsonTree* tree ) const
+void Var<std::string>::write( const std::string& value, const std::string& name, ci::JsonTree* tree )
 {
-	auto v = ci::JsonTree{ name, mValue };
+	auto v = ci::JsonTree{ name, value };
 	tree->addChild( v );
 }
 
@@ -573,7 +2377,7 @@ namespace
 			{
 				result += ' ';
 			}
-			result += std::to_string(elem);
+			appendNumber(&result, elem);
 		}
 
 		return result;
@@ -581,160 +2385,184 @@ namespace
 }
 
 template<>
-void Var<std::vector<float>>::save( const std::string& name, ci::JsonTree* tree ) const
+void Var<std::vector<float>>::write( const std::vector<float>& value, const std::string& name, ci::JsonTree* tree )
 {
-	auto v = ci::JsonTree{ name, writeVector(mValue) };
+	auto v = ci::JsonTree{ name, writeVector(value) };
 	tree->addChild( v );
 }
 
 template<>
-void Var<std::vector<int>>::save( const std::string& name, ci::JsonTree* tree ) const
+void Var<std::vector<int>>::write( const std::vector<int>& value, const std::string& name, ci::JsonTree* tree )
 {
-	auto v = ci::JsonTree{ name, writeVector(mValue) };
+	auto v = ci::JsonTree{ name, writeVector(value) };
 	tree->addChild( v );
 }
 
+void JsonBag::writeBinary( VarType type, std::string_view data, const std::string& name, JsonTree* tree )
+{
+	auto write = [&] ( auto typedValue ) {
+		using T = decltype( typedValue );
+		T value;
+		if( BinaryCodec<T>::read( data, &value ) )
+			Var<T>::write( value, name, tree );
+	};
+
+	switch( type ) {
+		case VarType::Bool:			write( bool{} ); break;
+		case VarType::Int:			write( int{} ); break;
+		case VarType::Float:		write( float{} ); break;
+		case VarType::IVec2:		write( glm::ivec2{} ); break;
+		case VarType::IVec3:		write( glm::ivec3{} ); break;
+		case VarType::IVec4:		write( glm::ivec4{} ); break;
+		case VarType::Vec2:			write( glm::vec2{} ); break;
+		case VarType::Vec3:			write( glm::vec3{} ); break;
+		case VarType::Vec4:			write( glm::vec4{} ); break;
+		case VarType::Quat:			write( glm::quat{} ); break;
+		case VarType::Color:		write( ci::Color{} ); break;
+		case VarType::String:		write( std::string{} ); break;
+		case VarType::IntVector:	write( std::vector<int>{} ); break;
+		case VarType::FloatVector:	write( std::vector<float>{} ); break;
+		default:					CI_LOG_E( "Cannot save " + name + ": unsupported type" ); break;
+	}
+}
+
 
 template<>
-void Var<bool>::load( const JsonTree& tree )
+bool Var<bool>::parse( const VarDocument::Value& value )
 {
-	update( tree.getValue<bool>() );
+	return parseBool( value.text );
 }
 
 template<>
-void Var<int>::load( const JsonTree& tree )
+int Var<int>::parse( const VarDocument::Value& value )
 {
-	update( tree.getValue<int>() );
+	return parseNumber<int>( value.text );
 }
 
 template<>
-void Var<float>::load( const JsonTree& tree )
+float Var<float>::parse( const VarDocument::Value& value )
 {
-	update( tree.getValue<float>() );
+	return parseNumber<float>( value.text );
 }
 
 template<>
-void Var<glm::ivec2>::load(const JsonTree& tree)
+glm::ivec2 Var<glm::ivec2>::parse( const VarDocument::Value& value )
 {
 	glm::ivec2 v;
-	v.x = tree.getChild("x").getValue<int>();
-	v.y = tree.getChild("y").getValue<int>();
-	update(v);
+	v.x = parseNumber<int>( value.field( "x" ) );
+	v.y = parseNumber<int>( value.field( "y" ) );
+	return v;
 }
 
 template<>
-void Var<glm::ivec3>::load(const JsonTree& tree)
+glm::ivec3 Var<glm::ivec3>::parse( const VarDocument::Value& value )
 {
 	glm::ivec3 v;
-	v.x = tree.getChild("x").getValue<int>();
-	v.y = tree.getChild("y").getValue<int>();
-	v.z = tree.getChild("z").getValue<int>();
-	update(v);
+	v.x = parseNumber<int>( value.field( "x" ) );
+	v.y = parseNumber<int>( value.field( "y" ) );
+	v.z = parseNumber<int>( value.field( "z" ) );
+	return v;
 }
 
 template<>
-void Var<glm::ivec4>::load(const JsonTree& tree)
+glm::ivec4 Var<glm::ivec4>::parse( const VarDocument::Value& value )
 {
 	glm::ivec4 v;
-	v.x = tree.getChild("x").getValue<int>();
-	v.y = tree.getChild("y").getValue<int>();
-	v.z = tree.getChild("z").getValue<int>();
-	v.w = tree.getChild("w").getValue<int>();
-	update(v);
+	v.x = parseNumber<int>( value.field( "x" ) );
+	v.y = parseNumber<int>( value.field( "y" ) );
+	v.z = parseNumber<int>( value.field( "z" ) );
+	v.w = parseNumber<int>( value.field( "w" ) );
+	return v;
 }
 
 template<>
-void Var<glm::vec2>::load( const JsonTree& tree )
+glm::vec2 Var<glm::vec2>::parse( const VarDocument::Value& value )
 {
 	glm::vec2 v;
-	v.x = tree.getChild( "x" ).getValue<float>();
-	v.y = tree.getChild( "y" ).getValue<float>();
-	update( v );
+	v.x = parseNumber<float>( value.field( "x" ) );
+	v.y = parseNumber<float>( value.field( "y" ) );
+	return v;
 }
 
 template<>
-void Var<glm::vec3>::load( const JsonTree& tree )
+glm::vec3 Var<glm::vec3>::parse( const VarDocument::Value& value )
 {
 	glm::vec3 v;
-	v.x = tree.getChild( "x" ).getValue<float>();
-	v.y = tree.getChild( "y" ).getValue<float>();
-	v.z = tree.getChild( "z" ).getValue<float>();
-	update( v );
+	v.x = parseNumber<float>( value.field( "x" ) );
+	v.y = parseNumber<float>( value.field( "y" ) );
+	v.z = parseNumber<float>( value.field( "z" ) );
+	return v;
 }
 
 template<>
-void Var<glm::vec4>::load( const JsonTree& tree )
+glm::vec4 Var<glm::vec4>::parse( const VarDocument::Value& value )
 {
 	glm::vec4 v;
-	v.x = tree.getChild( "x" ).getValue<float>();
-	v.y = tree.getChild( "y" ).getValue<float>();
-	v.z = tree.getChild( "z" ).getValue<float>();
-	v.w = tree.getChild( "w" ).getValue<float>();
-	update( v );
+	v.x = parseNumber<float>( value.field( "x" ) );
+	v.y = parseNumber<float>( value.field( "y" ) );
+	v.z = parseNumber<float>( value.field( "z" ) );
+	v.w = parseNumber<float>( value.field( "w" ) );
+	return v;
 }
 
 template<>
-void Var<glm::quat>::load( const JsonTree& tree )
+glm::quat Var<glm::quat>::parse( const VarDocument::Value& value )
 {
 	glm::quat q;
-	q.w = tree.getChild( "w" ).getValue<float>();
-	q.x = tree.getChild( "x" ).getValue<float>();
-	q.y = tree.getChild( "y" ).getValue<float>();
-	q.z = tree.getChild( "z" ).getValue<float>();
-	update( q );
+	q.w = parseNumber<float>( value.field( "w" ) );
+	q.x = parseNumber<float>( value.field( "x" ) );
+	q.y = parseNumber<float>( value.field( "y" ) );
+	q.z = parseNumber<float>( value.field( "z" ) );
+	return q;
 }
 
 template<>
-void Var<ci::Color>::load( const JsonTree& tree )
+ci::Color Var<ci::Color>::parse( const VarDocument::Value& value )
 {
 	ci::Color c;
-	c.r = tree.getChild( "r" ).getValue<float>();
-	c.g = tree.getChild( "g" ).getValue<float>();
-	c.b = tree.getChild( "b" ).getValue<float>();
-	update( c );
+	c.r = parseNumber<float>( value.field( "r" ) );
+	c.g = parseNumber<float>( value.field( "g" ) );
+	c.b = parseNumber<float>( value.field( "b" ) );
+	return c;
 }
 
 template<>
-void Var<std::string>::load( const JsonTree& tree )
+std::string Var<std::string>::parse( const VarDocument::Value& value )
 {
-	auto fp = tree.getValue<std::string>();
-	update( fp );
+	return std::string{ value.text };
 }
 
 namespace
 {
 	template <class T>
-	std::vector<T> parseVector(const std::string & string)
+	std::vector<T> parseVector(std::string_view string)
 	{
 		std::vector<T> result;
 
-		std::istringstream input(string);
-		while(!input.eof())
+		const char * it = string.data();
+		const char * end = string.data() + string.size();
+		while(skipSpaces(it, end) != end)
 		{
 			T value = T();
-			if(input >> value)
-			{
-				result.push_back(value);
-			}
-			else
+			it = readNumber(it, end, &value);
+			if(!it)
 			{
 				break;
 			}
+			result.push_back(value);
 		}
 		return result;
 	}
 }
 
-template <>
-void Var<std::vector<float>>::load( const JsonTree& tree )
+template<>
+std::vector<float> Var<std::vector<float>>::parse( const VarDocument::Value& value )
 {
-	auto fp = tree.getValue<std::string>();
-	update(parseVector<float>(fp));
+	return parseVector<float>(value.text);
 }
 
-template <>
-void Var<std::vector<int>>::load( const JsonTree& tree )
+template<>
+std::vector<int> Var<std::vector<int>>::parse( const VarDocument::Value& value )
 {
-	auto fp = tree.getValue<std::string>();
-	update(parseVector<int>(fp));
+	return parseVector<int>(value.text);
 }
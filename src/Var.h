@@ -6,12 +6,30 @@
 #include "cinder/Signals.h"
 
 #include <map>
+#include <set>
+#include <unordered_set>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <future>
 
 #include "cinder/gl/gl.h"
 #include "cinder/Thread.h"
 #include "cinder/ConcurrentCircularBuffer.h"
 
+#include "ConcurrentValue.h"
+#include "VarArena.h"
+#include "VarTransitions.h"
+#include "VarBinary.h"
+#include "VarRegistry.h"
+#include "VarDocument.h"
+#include "VarStats.h"
+#include "VarProfiler.h"
+#include "VarSocket.h"
+#include "VarSharedMemory.h"
+#include "VarLog.h"
+
 // Eric Renaud-Houde - Jan 2015
 // Credit to Rich's live DartBag work.
 
@@ -20,6 +38,7 @@ namespace cinder {
 	class JsonBag;
 	class VarBase;
 	template<typename T> class Var;
+	template<typename T> class ArenaVar;
 	template<typename T> class DynamicVar;
 	struct IDynamicVarContainer;
 
@@ -32,10 +51,112 @@ namespace cinder {
 		void setFilepath( const fs::path& filepath );
 		const fs::path& getFilepath() const;
 		
-		void save() const;
-		void save( const fs::path& path ) const;
-		void load( const fs::path& path );
+		/// Copies the values and writes them on the bag's save thread, to a temporary file renamed over \a path
+		/// so that a crash never leaves a partial file. Saves never wait for the loads in progress, the future
+		/// is true once the file is replaced.
+		/// Without \a path, writes the last loaded file, or the changed shards when sharded.
+		std::future<bool> save();
+		std::future<bool> save( const fs::path& path );
+
+		/// Splits the values into one file per group in \a directory, or per shard name returned by
+		/// \a shardName for a group. save() then only writes the shards whose values changed, and loading a
+		/// shard file only applies its own groups. An empty \a directory restores the single file layout.
+		void setShardDirectory( const fs::path& directory, const std::function<std::string( const std::string& groupName )>& shardName = nullptr );
+		fs::path getShardDirectory() const;
+		/// Parses every shard of the shard directory in parallel, then applies them in a single transaction.
+		std::vector<VarBase*> loadShards();
+		/// Loads \a path and returns the vars whose value it changed.
+		std::vector<VarBase*> load( const fs::path& path );
+		/// Reads and parses \a path on a worker thread. The result is applied by the next update().
+		/// When the worker's queue is full, the load is retried by the next update() instead.
 		void loadAsync( const fs::path& path );
+		/// Reloads \a path once it stopped changing for the quiet window, e.g. from a file watcher callback.
+		/// Bursts of calls result in a single load per file, files that fail to parse are retried. Driven by update().
+		void scheduleReload( const fs::path& path );
+		void setReloadQuietWindow( double seconds );
+		double getReloadQuietWindow() const;
+		/// Starts the scheduled reloads when due and applies the documents parsed since the last call, in order.
+		/// Call once per frame from the main thread.
+		std::vector<VarBase*> update();
+		/// Limits the number of vars update() applies per call, 0 (the default) applies each document at once.
+		/// A larger document is then applied over several frames, and isLoaded() is false until it is complete.
+		void setMaxVarsPerUpdate( size_t count ) { mMaxVarsPerUpdate = count; }
+		size_t getMaxVarsPerUpdate() const { return mMaxVarsPerUpdate; }
+
+		/// Serves the requests of local tools on the Unix domain socket \a socketPath, see VarSocketServer: set,
+		/// get and subscribe to vars by "group.name" without going through the file. Requests are handled by
+		/// update(), values set this way are written by the next save(). The socket file gets the permissions \a mode,
+		/// only the current user by default. Returns false when the socket cannot be bound.
+		bool listen( const fs::path& socketPath, int mode = 0600 );
+		void stopListening();
+
+		/// Publishes the values of the fixed-size vars (bools, numbers, vectors, colors) in the POSIX shared memory
+		/// object \a name, e.g. "/live_vars", refreshed by update(). The processes subscribed to \a name then get
+		/// every change without reading the file. The object gets the permissions \a mode, only the current user by
+		/// default. Returns false when the object cannot be created.
+		bool publishSharedMemory( const std::string& name, int mode = 0600 );
+		/// Applies the values published under \a name by another process to the vars with the same "group.name"
+		/// and type, from update(). Waits for the object when it is not published yet.
+		void subscribeSharedMemory( const std::string& name );
+		void closeSharedMemory();
+
+		/// Appends every change of the vars' values to the binary log \a path (see VarLog), with its time.
+		/// Changes are buffered and written by the worker thread. Returns false when \a path cannot be created.
+		bool startRecording( const fs::path& path );
+		void stopRecording();
+		bool isRecording() const { return mRecording; }
+		/// Applies the changes recorded in \a path from update(): at the pace they were recorded, or one recorded
+		/// frame per update() when \a originalSpeed is false. Returns false when \a path is not a log.
+		bool startReplay( const fs::path& path, bool originalSpeed = true );
+		void stopReplay();
+		bool isReplaying() const { return mReplay != nullptr; }
+
+		/// When enabled, load() only touches (and notifies) the vars whose serialized value changed since the last load,
+		/// and the vars given another value since, e.g. assigned or edited, which get the file's value back.
+		void setIncrementalReload( bool enabled ) { mIncrementalReload = enabled; }
+		bool isIncrementalReload() const { return mIncrementalReload; }
+
+		/// When enabled, loading a JSON file also writes a binary snapshot next to it (e.g. live_vars.json.cache).
+		/// Later loads map the snapshot instead of parsing the JSON file, as long as the JSON file did not change.
+		void setSnapshotEnabled( bool enabled ) { mSnapshotEnabled = enabled; }
+		bool isSnapshotEnabled() const { return mSnapshotEnabled; }
+
+		/// Defers the update callbacks of the vars changed on this thread until the matching endTransaction().
+		/// Each changed var is then notified once, followed by its group's and the bag's changed signals.
+		/// Transactions nest; load() and update() apply documents in a transaction. While one runs, the vars of
+		/// the bag must only be destroyed on its thread, which for update() is the main thread.
+		void beginTransaction();
+		void endTransaction();
+
+		typedef ci::signals::Signal<void( const std::vector<VarBase*>& )>	ChangedSignal;
+		/// Emitted once per transaction with the vars whose value changed.
+		ChangedSignal& getSignalChanged() { return mSignalChanged; }
+		/// Emitted once per transaction with the vars of \a groupName whose value changed.
+		ChangedSignal& getSignalGroupChanged( const std::string& groupName );
+
+		/// Loaded values of the float-based vars (float, vecs, Color) of \a groupName reach their new value over
+		/// \a duration seconds instead of snapping to it, see VarBase::setTransition(). Advanced by update().
+		void setGroupTransition( const std::string& groupName, float duration, VarEaseFn easing = nullptr );
+
+		/// Calls \a kernel( T* values, size_t count ) on each contiguous block of the values of the ArenaVar<T>
+		/// of the bag, e.g. to interpolate or clamp them all at once. Writes do not notify the vars, nor reach the
+		/// shared memory of publishSharedMemory().
+		template<typename T, typename Kernel>
+		void forEachArenaBlock( Kernel kernel )
+		{
+			if( auto arena = getArena<T>( false ) )
+				arena->forEachBlock( kernel );
+		}
+
+		/// Number of loads skipped because the file still held what save() last wrote to it.
+		size_t getSkippedReloadCount() const { return mSkippedReloads; }
+
+		/// Totals of the loads and saves since the bag was created or resetStats() was called.
+		VarStats getStats() const;
+		void resetStats();
+		/// Called after each load and save with its counters and timings, on the thread that applied the load
+		/// and on the save thread for saves. Keep it short, e.g. push the event to a metrics queue.
+		void setEventHook( const std::function<void( const VarEvent& )>& hook );
 
 		void addDynamicVarContainer(std::string name, IDynamicVarContainer * container);
 
@@ -44,26 +165,226 @@ namespace cinder {
 		bool isLoaded() const { return mIsLoaded; }
 
 		const VarMap& getItems() const { return mItems; }
-		VarBase * findVar(const std::string & fullName) const;
+
+		/// Unregisters all \a vars under a single lock, e.g. before tearing down a scene.
+		/// Their destructors then skip the bag.
+		void remove( const std::vector<VarBase*>& vars );
+		/// Unregisters every var of \a groupName.
+		void removeGroup( const std::string& groupName );
+		/// Thread-safe and allocation-free lookup of a "group.varName" var.
+		VarBase * findVar(std::string_view fullName) const;
 		bool findVarName(const VarBase * var, std::string *name, std::string *groupName) const;
 
-	private:
+		/// Independent from bag(), with its own vars, file and locks. Vars join it through their JsonBag& constructor.
 		JsonBag();
+		/// Its remaining vars are unregistered.
+		~JsonBag();
+
+	private:
+
+		struct ParsedDocument {
+			fs::path					path;
+			std::shared_ptr<VarDocument>	doc;	// null when the file is missing or invalid
+			bool							notified = false;	// read by scheduleReload()
+		};
+
+		// a document being applied, over several update() calls when setMaxVarsPerUpdate() limits them
+		struct PendingApply {
+			fs::path						path;
+			std::shared_ptr<VarDocument>	doc;
+			bool							notified = false;
+			bool							shard = false;
+			VarEvent						event;
+			// the next var to apply, name empty at the start of a group
+			std::string						groupName, name;
+		};
+
+		// the state of the vars at save() time, written by the save thread
+		struct SavedVar {
+			std::string						name;
+			VarType							type;		// of the binary form, Unknown when saved as json
+			size_t							offset, size;
+			std::string						connection;
+			std::unique_ptr<ci::JsonTree>	json;
+		};
+		struct SavedState {
+			std::vector<std::pair<std::string, std::vector<SavedVar>>>	groups;
+			std::vector<char>				binary;
+			std::unique_ptr<ci::JsonTree>	dynamics;
+			int								version;
+			uint64_t						applyGeneration;
+		};
+
+		// the last content written by save() to a file, to recognize it when the file watcher reloads it
+		struct WrittenFile {
+			uint64_t	size = 0;
+			int64_t		time = 0;
+			uint64_t	hash = 0;
+		};
+
+		// a save to the bag's own file, whose hashes update() gives to the vars unless a load was applied since the capture
+		struct SavedDocument {
+			std::shared_ptr<VarDocument>	doc;
+			uint64_t						applyGeneration;
+		};
+
+		struct ScheduledReload {
+			std::chrono::steady_clock::time_point	dueTime;
+			int										retries = 0;
+			bool									pending = false;
+			bool									running = false;
+			bool									notified = true;	// false for a loadAsync() that could not be queued
+		};
+
+		template<typename T>
+		std::shared_ptr<VarArena<T>> getArena( bool create )
+		{
+			std::lock_guard<std::mutex> lock( mArenaMutex );
+			auto& arena = mArenas[static_cast<size_t>( VarTypeOf<T>::value )];
+			if( ! arena && create )
+				arena = std::make_shared<VarArena<T>>();
+			return std::static_pointer_cast<VarArena<T>>( arena );
+		}
+
+		bool startTransition( VarBase* var, const VarDocument::Value& value );
+		void updateTransitions();
+		void startScheduledReload();
+		std::vector<VarBase*> updateSharedMemory();
+		void record( const VarBase* var );
+		void forgetRecordedVar( const VarBase* var );
+		void markShared( VarBase* var );
+		void flushRecording();
+		std::vector<VarBase*> updateReplay();
+		std::vector<VarBase*> handleSocketRequests();
+		//! Returns the error message, empty on success. Adds the var to \a changedVars when a "set" changed its value.
+		std::string handleSocketRequest( uint64_t client, const std::string& command, const std::string& name, const std::string& value, std::vector<VarBase*>* changedVars );
+		void sendValue( uint64_t client, const VarBase* var );
+		void deferNotification( VarBase* var );
+		void propagateConnections();
+		void cancelNotification( VarBase* var );
+		std::shared_ptr<SavedState> captureState( const std::set<std::string>* groupNames = nullptr );
+		static uint64_t hashShard( const SavedState& state, const std::vector<size_t>& groups, bool dynamics );
+		//! \a captureTime is reported with the save event.
+		bool write( const SavedState& state, const std::vector<size_t>& groups, bool dynamics, const fs::path& path, double captureTime );
+		void report( const VarEvent& event );
+		std::future<bool> saveShards();
+		static fs::path normalizePath( const fs::path& path );
+		std::string getShardName( const std::string& groupName ) const;
+		fs::path getShardPath( const std::string& shardName ) const;
+		bool isShard( const fs::path& path ) const;
+		void updateShardHashes( const VarDocument& doc );
+		bool skipOwnWrite( const fs::path& path );
+		void queueLoadedHashes( const fs::path& path, const std::string& text, uint64_t applyGeneration );
+		void updateLoadedHashes();
+		void detachFromFile( VarBase* var );
+		static void writeBinary( VarType type, std::string_view data, const std::string& name, ci::JsonTree* tree );
+		//! Reports parse errors in \a error when given, logs them otherwise.
+		std::shared_ptr<VarDocument> read( const fs::path& path, std::string* error = nullptr ) const;
+		std::vector<VarBase*> apply( const fs::path& path, const std::shared_ptr<VarDocument>& doc, bool notified = false );
+		std::unique_ptr<PendingApply> beginApply( const fs::path& path, const std::shared_ptr<VarDocument>& doc, bool notified );
+		//! Applies the values from where the previous call stopped, one per unit of \a budget. Returns true once done.
+		bool applyValues( PendingApply* pending, size_t* budget, std::vector<VarBase*>* changedVars );
+		void finishApply( PendingApply* pending );
+		void writeSnapshot( const std::shared_ptr<VarDocument>& doc );
+		bool post( const std::function<void()>& job );
+		void workerThreadFn();
+		void postSave( const std::function<void()>& job );
+		void saveThreadFn();
+
+		VarBase * findVarLocked(std::string_view fullName) const;
 
 		void emplace( VarBase* var, const std::string& name, const std::string groupName );
-		void removeTarget( void* target );
+		void remove( VarBase* var );
+		void removeLocked( VarBase* var );
 				
 		VarMap				mItems;
+		VarRegistry			mRegistry;
+		uint64_t			mRegistryGeneration;	// changes with the registered vars
+		std::map<std::string, size_t>	mGroupHashes;
+		uint64_t			mApplyGeneration;	// changes with each apply, guarded by mItemsMutex
+		std::map<std::string, std::pair<float, VarEaseFn>>	mGroupTransitions;
+		VarTransitions		mTransitions;
+		std::chrono::steady_clock::time_point	mLastTransitionsUpdate;
 		ci::fs::path		mJsonFilePath;
 		std::unordered_map<std::string, IDynamicVarContainer *> mDynamicVarContainers;
 		std::atomic<int>	mVersion;
 		std::atomic<bool>	mIsLoaded;
-		mutable std::mutex	mItemsMutex, mPathMutex, mFactoryProviderMutex;
+		std::atomic<bool>	mIncrementalReload;
+		std::atomic<bool>	mSnapshotEnabled;
+		std::shared_ptr<VarArenaBase>	mArenas[VAR_TYPE_COUNT];
+		std::mutex			mArenaMutex;
+		std::atomic<size_t>	mSkippedReloads;
+		std::map<fs::path, WrittenFile>	mLastWrites;	// by normalized path
+		std::vector<SavedDocument>		mSavedDocuments;	// guarded by mLastWriteMutex
+		// sharded layout, guarded by mPathMutex
+		fs::path			mShardDirectory;
+		std::function<std::string( const std::string& )>	mShardName;
+		std::map<std::string, uint64_t>	mShardHashes;	// of the content last loaded or saved
+		VarStats			mStats;
+		std::map<fs::path, int64_t>	mAppliedSourceTimes;	// of the last applied document, by normalized path
+		std::function<void( const VarEvent& )>	mEventHook;
+		std::map<fs::path, ScheduledReload>	mScheduledReloads;	// by path, while pending or running
+		std::chrono::steady_clock::duration	mReloadQuietWindow;
+
+		// only touched by the thread running the transaction
+		std::atomic<std::thread::id>		mTransactionThread;
+		int									mTransactionDepth;
+		std::vector<VarBase*>				mPendingNotifications, mChangedVars;
+		// connected vars, inputs first
+		std::vector<VarBase*>				mPropagationOrder;
+		std::atomic<bool>					mPropagationOrderDirty;
+		ChangedSignal						mSignalChanged;
+		std::map<std::string, ChangedSignal>	mGroupSignalsChanged;
+		mutable std::mutex	mItemsMutex, mPathMutex, mFactoryProviderMutex, mLastWriteMutex, mReloadMutex, mStatsMutex, mRecordMutex, mSharedMutex;
+		// when publishing, the vars changed since the last update(), guarded by mSharedMutex
+		std::unordered_set<const VarBase*>	mSharedChangedVars;
+
+		// main thread only
+		std::unique_ptr<VarSocketServer>	mSocketServer;
+		std::string							mSharedMemoryName;
+		std::atomic<bool>					mSharedMemoryWriter;	// also read by VarBase::callUpdateFn()
+		int									mSharedMemoryMode;
+		std::unique_ptr<VarSharedMemory>	mSharedMemory;
+		std::unordered_map<const VarBase*, size_t>	mSharedEntries;	// when publishing, the entry of each var
+		std::vector<std::pair<VarBase*, size_t>>	mSharedVars;	// when subscribed, and their entry
+		std::vector<uint32_t>				mSharedSequences;	// last applied, when subscribed
+		uint64_t							mSharedVarsGeneration;
+		std::vector<char>					mSharedValue;
+		std::unique_ptr<VarLog::Reader>		mReplay;
+		bool								mReplayOriginalSpeed;
+		std::chrono::steady_clock::time_point	mReplayStartTime;
+		std::vector<std::string>			mReplayNames;	// by handle
+		std::vector<VarBase*>				mReplayVars;	// by handle, resolved from the names
+		uint64_t							mReplayVarsGeneration;
+
+		// guarded by mRecordMutex
+		std::atomic<bool>					mRecording;
+		std::shared_ptr<std::ofstream>		mRecordFile;	// written by the worker thread
+		std::vector<char>					mRecordBuffer;
+		std::unordered_map<const VarBase*, uint32_t>	mRecordHandles;
+		uint32_t							mNextRecordHandle;	// never reused, handles of forgotten vars stay in the log
+		std::chrono::steady_clock::time_point	mRecordStartTime;
+		bool								mRecordFramePending;	// changes recorded since the last frame
+		std::map<std::pair<uint64_t, std::string>, ci::signals::ScopedConnection>	mSubscriptions;	// by client and var
+
+		// reads, parses and writes files off the main thread
+		std::unique_ptr<std::thread>						mWorkerThread;
+		std::mutex											mWorkerThreadMutex;
+		ConcurrentCircularBuffer<std::function<void()>>		mWorkerJobs;
+		ConcurrentCircularBuffer<ParsedDocument>			mParsedDocuments;
+		std::unique_ptr<PendingApply>						mPendingApply;	// main thread only
+
+		// writes the saves in order, apart from the loads that wait for update() to take their documents
+		std::unique_ptr<std::thread>						mSaveThread;
+		std::deque<std::function<void()>>					mSaveJobs;	// guarded by mSaveMutex
+		std::mutex											mSaveMutex;
+		std::condition_variable								mSaveCondition;
+		std::atomic<size_t>									mMaxVarsPerUpdate;
 
-		friend JsonBag& cinder::bag();
 		friend class VarBase;
 		template<typename T> friend class Var;
 		template<typename T> friend class DynamicVar;
+		template<typename T> friend class ArenaVar;
 	};
 	
 	class VarBase {
@@ -73,54 +394,154 @@ namespace cinder {
 		
 		void setOwner( JsonBag *owner ) { mOwner = owner; }
 		
+		/// With VAR_PROFILE_LISTENERS defined, the calls of \a updateFn are timed by VarListenerProfiler.
 		ci::signals::Connection addUpdateFn( const std::function<void()> &updateFn, bool call = false );
 		void callUpdateFn();
 		
         bool tryConnectFrom(VarBase * input);
         void disconnect();
+        /// Disconnects the vars connected to this one.
+        void disconnectOutputs();
         VarBase * getConnectedInput() const;
 
 		void * getTarget() const { return mVoidPtr; }
+		/// The value of a Var<T> or ArenaVar<T>, \a T matching getType().
+		template<typename T>
+		const T& getValue() const { return *static_cast<const T*>( mVoidPtr ); }
+		/// Assigns a Var<T> or ArenaVar<T> as their operator= does, \a T matching getType().
+		template<typename T>
+		void setValue( const T& value )
+		{
+			if( isTransitioning() )
+				cancelTransition();
+			T& current = *static_cast<T*>( mVoidPtr );
+			if( current != value ) {
+				current = value;
+				valueWritten();
+			}
+		}
+
+		virtual VarType getType() const { return VarType::Unknown; }
+		/// Appends the binary form of the value (see BinaryCodec). Returns false if the type has none.
+		virtual bool saveBinary( std::vector<char>* ) const { return false; }
+		virtual bool loadBinary( std::string_view ) { return false; }
+		/// Appends the binary form of a document value, without applying it.
+		virtual bool encodeBinary( const VarDocument::Value&, std::vector<char>* ) const { return false; }
+
+		/// Loaded values reach their new value over \a duration seconds instead of snapping to it. Overrides the
+		/// group's transition, a negative \a duration restores it. Only applies to float-based vars (float, vecs, Color).
+		void setTransition( float duration, VarEaseFn easing = nullptr ) { mTransitionDuration = duration; mTransitionEasing = easing; }
+		/// True while a loaded value is being reached. Assigning a value cancels the transition.
+		bool isTransitioning() const { return mTransitionIndex != VarTransitions::NONE; }
+
+		/// Name and group the var is registered with in its owner bag (empty when not registered).
+		const std::string& getName() const;
+		const std::string& getGroupName() const;
 
 		virtual bool draw( const std::string& name ) = 0;
+		/// Publishes and notifies a value written in place, e.g. by a transition.
+		virtual void valueWritten() { callUpdateFn(); }
 		virtual void save( const std::string& name, ci::JsonTree* tree ) const = 0;
-		virtual void load( const ci::JsonTree& tree ) = 0;
+		virtual void load( const VarDocument::Value& value ) = 0;
 		virtual void restoreDefault( ) = 0;
 	protected:
 		ci::signals::Signal<void()>	mUpdateFn;
-        ci::signals::ScopedConnection mConnection;
+		// connections are propagated by the owner bag, see JsonBag::propagateConnections()
         VarBase * mConnectedInput;
+        std::function<void()> mPullInput;
+        std::vector<VarBase*> mConnectedOutputs;
 
 		JsonBag*	mOwner;
 		void*		mVoidPtr;
+
+		void cancelTransition();
+	private:
+		size_t		mLoadedHash;
+		bool		mNotificationPending;
+		float		mTransitionDuration;
+		VarEaseFn	mTransitionEasing;
+		uint32_t	mTransitionIndex;	// in the owner's VarTransitions, see VarTransitions::start()
+		// position in the owner's VarMap and registry, valid while mOwner is set
+		VarMap::iterator					mGroupIt;
+		VarMap::mapped_type::iterator		mItemIt;
+		size_t								mRegistrySlot;
+
+		friend class JsonBag;
 	};
 	
 	template<typename T>
 	class Var : public ci::Noncopyable, public VarBase {
 	public:
 		Var( const T& value, const std::string& name, const std::string& groupName = "default", float min = 0.0f, float max = 1.0f )
+		: Var{ ci::bag(), value, name, groupName, min, max }
+		{}
+		/// Registers the var in \a bag instead of the default bag().
+		Var( JsonBag& bag, const T& value, const std::string& name, const std::string& groupName = "default", float min = 0.0f, float max = 1.0f )
 		: VarBase{ &mValue }
 		, mValue{ value }
 		, mValueRange{ min, max }
 		, mDefaultValue{ value }
 		{
-			ci::bag().emplace( this, name, groupName );
+			bag.emplace( this, name, groupName );
 		}
 		virtual ~Var() { }
 
-		virtual operator const T&() const { return mValue; }
+		// the read path is non-virtual: a read is a call to an inline accessor, never through the vtable
+		operator const T&() const { return mValue; }
 		
-		virtual Var<T>& operator=( const T& value )
+		Var<T>& operator=( const T& value )
 		{
+			if( isTransitioning() )
+				cancelTransition();
 			update( value );
 			return *this;
 		}		
-		virtual const T&	value() const { return mValue; }
-		virtual const T&	operator()() const { return mValue; }
+		const T&	value() const { return mValue; }
+		const T&	operator()() const { return mValue; }
+
+		/// Publishes every update so that concurrentValue() can be read from any thread.
+		/// Call it from the main thread before other threads start reading.
+		void enableConcurrentReads()
+		{
+			if( ! mConcurrentValue )
+				mConcurrentValue.reset( new ConcurrentValue<T>{ mValue } );
+		}
+		bool hasConcurrentReads() const { return mConcurrentValue != nullptr; }
+
+		virtual VarType getType() const override { return VarTypeOf<T>::value; }
+		virtual bool saveBinary( std::vector<char>* out ) const override { return BinaryCodec<T>::write( mValue, out ); }
+		virtual bool loadBinary( std::string_view data ) override
+		{
+			T value;
+			if( ! BinaryCodec<T>::read( data, &value ) )
+				return false;
+			update( value );
+			return true;
+		}
+		virtual bool encodeBinary( const VarDocument::Value& value, std::vector<char>* out ) const override
+		{
+			return BinaryCodec<T>::write( parse( value ), out );
+		}
+
+		virtual void valueWritten() override
+		{
+			if( mConcurrentValue )
+				mConcurrentValue->store( mValue );
+			callUpdateFn();
+		}
+
+		/// A consistent copy of the value, safe to call from any thread once enableConcurrentReads() was called.
+		T concurrentValue() const
+		{
+			CI_ASSERT( mConcurrentValue );
+			return mConcurrentValue->load();
+		}
 	protected:
 		void update( const T& value ) {
 			if( mValue != value ) {
 				mValue = value;
+				if( mConcurrentValue )
+					mConcurrentValue->store( mValue );
 				callUpdateFn();
 			}
 		}
@@ -129,8 +550,12 @@ namespace cinder {
 #else
 		virtual bool draw( const std::string& name ) override { return false; }
 #endif
-		virtual void save( const std::string& name, ci::JsonTree* tree ) const override;
-		virtual void load( const ci::JsonTree& tree ) override;
+		virtual void save( const std::string& name, ci::JsonTree* tree ) const override { write( mValue, name, tree ); }
+		virtual void load( const VarDocument::Value& value ) override { update( parse( value ) ); }
+		//! Specialized for each supported type.
+		static void write( const T& value, const std::string& name, ci::JsonTree* tree );
+		//! Specialized for each supported type. Throws JsonTree::ExcJsonParserError on invalid content.
+		static T parse( const VarDocument::Value& value );
 		virtual void restoreDefault( ) override {
 			update( mDefaultValue );
 		}
@@ -138,7 +563,103 @@ namespace cinder {
 		T						mValue;
 		std::pair<float, float>	mValueRange;
 		T						mDefaultValue;
+		std::unique_ptr<ConcurrentValue<T>>	mConcurrentValue;
 		friend class JsonBag;
+		template<typename U> friend class ArenaVar;
 	};
+
+	/// A var whose value lives in its bag's contiguous arena of T values instead of inside the var, so that
+	/// JsonBag::forEachArenaBlock() can process them all at once. The var only holds its slot in the arena.
+	/// Limited to the trivially copyable types with a binary form: bool, int, float, vectors, quat and Color.
+	template<typename T>
+	class ArenaVar : public ci::Noncopyable, public VarBase {
+		static_assert( std::is_trivially_copyable<T>::value && VarTypeOf<T>::value != VarType::Unknown, "not an arena type" );
+	public:
+		ArenaVar( const T& value, const std::string& name, const std::string& groupName = "default" )
+		: ArenaVar{ ci::bag(), value, name, groupName }
+		{}
+		/// Registers the var in \a bag instead of the default bag().
+		ArenaVar( JsonBag& bag, const T& value, const std::string& name, const std::string& groupName = "default" )
+		: VarBase{ nullptr }
+		, mArena{ bag.template getArena<T>( true ) }
+		, mValue{ mArena->allocate( value ) }
+		, mDefaultValue{ value }
+		{
+			mVoidPtr = mValue;
+			bag.emplace( this, name, groupName );
+		}
+		virtual ~ArenaVar()
+		{
+			// unregistered first, so that the bag never sees a freed value
+			if( mOwner )
+				mOwner->remove( this );
+			mArena->free( mValue );
+		}
+
+		operator const T&() const { return *mValue; }
+
+		ArenaVar<T>& operator=( const T& value )
+		{
+			if( isTransitioning() )
+				cancelTransition();
+			update( value );
+			return *this;
+		}
+		const T&	value() const { return *mValue; }
+		const T&	operator()() const { return *mValue; }
+
+		virtual VarType getType() const override { return VarTypeOf<T>::value; }
+		virtual bool saveBinary( std::vector<char>* out ) const override { return BinaryCodec<T>::write( *mValue, out ); }
+		virtual bool loadBinary( std::string_view data ) override
+		{
+			T value;
+			if( ! BinaryCodec<T>::read( data, &value ) )
+				return false;
+			update( value );
+			return true;
+		}
+		virtual bool encodeBinary( const VarDocument::Value& value, std::vector<char>* out ) const override
+		{
+			return BinaryCodec<T>::write( Var<T>::parse( value ), out );
+		}
+
+	protected:
+		void update( const T& value ) {
+			if( *mValue != value ) {
+				*mValue = value;
+				callUpdateFn();
+			}
+		}
+		virtual bool draw( const std::string& ) override { return false; }
+		virtual void save( const std::string& name, ci::JsonTree* tree ) const override { Var<T>::write( *mValue, name, tree ); }
+		virtual void load( const VarDocument::Value& value ) override { update( Var<T>::parse( value ) ); }
+		virtual void restoreDefault( ) override {
+			update( mDefaultValue );
+		}
+
+		std::shared_ptr<VarArena<T>>	mArena;
+		T*								mValue;		// the slot in mArena
+		T								mDefaultValue;
+		friend class JsonBag;
+	};
+
+	/// Gives \a output the value of its connected \a input.
+	typedef std::function<void( const VarBase& input, VarBase* output )>	VarConverter;
+
+	/// Sets how a var of type \a to connected to a var of type \a from takes its value, replacing the
+	/// previous converter. Identical types, DynamicVar <-> string, ivec -> vec, float -> vec broadcast
+	/// and Color <-> vec3 are set by default.
+	void setConnectionConverter( VarType from, VarType to, const VarConverter& converter );
+	/// Returns an empty converter when \a from and \a to cannot be connected.
+	VarConverter findConnectionConverter( VarType from, VarType to );
+
+	/// e.g. setConnectionConverter<glm::vec2, float>( [] ( const glm::vec2& v ) { return glm::length( v ); } )
+	template<typename From, typename To>
+	void setConnectionConverter( const std::function<To( const From& )>& convert )
+	{
+		setConnectionConverter( VarTypeOf<From>::value, VarTypeOf<To>::value, [convert] ( const VarBase& input, VarBase* output ) {
+			output->setValue<To>( convert( input.getValue<From>() ) );
+		} );
+	}
 } //namespace live
 
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace cinder {
+
+	class VarArenaBase {
+	public:
+		virtual ~VarArenaBase() = default;
+	};
+
+	/**
+	 * Contiguous storage for the values of the ArenaVar<T> of a bag, see JsonBag::forEachArenaBlock().
+	 *
+	 * Values are allocated in fixed-size blocks so that their address never changes. Freed slots
+	 * are reset to T() and reused, bulk kernels can process them like any other value.
+	 */
+	template<typename T>
+	class VarArena : public VarArenaBase {
+		static_assert( std::is_trivially_copyable<T>::value, "arena values are processed as plain memory" );
+	public:
+		static const size_t BLOCK_SIZE = 1024;
+
+		VarArena()
+		: mLastBlockSize( BLOCK_SIZE )
+		{}
+
+		T* allocate( const T& value )
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			T* slot;
+			if( ! mFreeSlots.empty() ) {
+				slot = mFreeSlots.back();
+				mFreeSlots.pop_back();
+			}
+			else {
+				if( mLastBlockSize == BLOCK_SIZE ) {
+					mBlocks.emplace_back( new T[BLOCK_SIZE]() );
+					mLastBlockSize = 0;
+				}
+				slot = mBlocks.back().get() + mLastBlockSize++;
+			}
+			*slot = value;
+			return slot;
+		}
+
+		void free( T* slot )
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			*slot = T();
+			mFreeSlots.push_back( slot );
+		}
+
+		//! Calls \a kernel( T* values, size_t count ) on each block, under the arena lock.
+		template<typename Kernel>
+		void forEachBlock( Kernel kernel )
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			for( size_t i = 0; i < mBlocks.size(); ++i )
+				kernel( mBlocks[i].get(), i + 1 == mBlocks.size() ? mLastBlockSize : BLOCK_SIZE );
+		}
+
+	private:
+		std::mutex							mMutex;
+		std::vector<std::unique_ptr<T[]>>	mBlocks;
+		size_t								mLastBlockSize;
+		std::vector<T*>						mFreeSlots;
+	};
+
+} //namespace cinder
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/Color.h"
+#include "cinder/Quaternion.h"
+#include "cinder/Vector.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace cinder {
+
+	//! Identifies the value type of a var, e.g. in binary snapshots. Stored in files: only append.
+	enum class VarType : uint8_t {
+		Unknown = 0,
+		Bool, Int, Float,
+		IVec2, IVec3, IVec4,
+		Vec2, Vec3, Vec4,
+		Quat, Color,
+		String, IntVector, FloatVector,
+		Dynamic
+	};
+	//! Number of VarType values, to update when appending one.
+	static const size_t VAR_TYPE_COUNT = static_cast<size_t>( VarType::Dynamic ) + 1;
+
+	template<typename T> struct VarTypeOf								{ static const VarType value = VarType::Unknown; };
+	template<> struct VarTypeOf<bool>								{ static const VarType value = VarType::Bool; };
+	template<> struct VarTypeOf<int>								{ static const VarType value = VarType::Int; };
+	template<> struct VarTypeOf<float>								{ static const VarType value = VarType::Float; };
+	template<> struct VarTypeOf<glm::ivec2>							{ static const VarType value = VarType::IVec2; };
+	template<> struct VarTypeOf<glm::ivec3>							{ static const VarType value = VarType::IVec3; };
+	template<> struct VarTypeOf<glm::ivec4>							{ static const VarType value = VarType::IVec4; };
+	template<> struct VarTypeOf<glm::vec2>							{ static const VarType value = VarType::Vec2; };
+	template<> struct VarTypeOf<glm::vec3>							{ static const VarType value = VarType::Vec3; };
+	template<> struct VarTypeOf<glm::vec4>							{ static const VarType value = VarType::Vec4; };
+	template<> struct VarTypeOf<glm::quat>							{ static const VarType value = VarType::Quat; };
+	template<> struct VarTypeOf<ci::Color>							{ static const VarType value = VarType::Color; };
+	template<> struct VarTypeOf<std::string>						{ static const VarType value = VarType::String; };
+	template<> struct VarTypeOf<std::vector<int>>					{ static const VarType value = VarType::IntVector; };
+	template<> struct VarTypeOf<std::vector<float>>					{ static const VarType value = VarType::FloatVector; };
+
+	/**
+	 * Raw binary form of a var value, in native byte order.
+	 *
+	 * Trivially copyable values are stored as is, strings and vectors as their contiguous
+	 * content. Other types have no binary form: write() and read() return false.
+	 */
+	template<typename T, typename Enable = void>
+	struct BinaryCodec {
+		static bool write( const T&, std::vector<char>* ) { return false; }
+		static bool read( std::string_view, T* ) { return false; }
+	};
+
+	template<typename T>
+	struct BinaryCodec<T, typename std::enable_if<std::is_trivially_copyable<T>::value>::type> {
+		static bool write( const T& value, std::vector<char>* out )
+		{
+			const char* bytes = reinterpret_cast<const char*>( &value );
+			out->insert( out->end(), bytes, bytes + sizeof( T ) );
+			return true;
+		}
+		static bool read( std::string_view data, T* value )
+		{
+			if( data.size() != sizeof( T ) )
+				return false;
+			std::memcpy( value, data.data(), sizeof( T ) );
+			return true;
+		}
+	};
+
+	template<>
+	struct BinaryCodec<std::string> {
+		static bool write( const std::string& value, std::vector<char>* out )
+		{
+			out->insert( out->end(), value.begin(), value.end() );
+			return true;
+		}
+		static bool read( std::string_view data, std::string* value )
+		{
+			value->assign( data.data(), data.size() );
+			return true;
+		}
+	};
+
+	template<typename T>
+	struct BinaryCodec<std::vector<T>, typename std::enable_if<std::is_trivially_copyable<T>::value>::type> {
+		static bool write( const std::vector<T>& value, std::vector<char>* out )
+		{
+			const char* bytes = reinterpret_cast<const char*>( value.data() );
+			out->insert( out->end(), bytes, bytes + value.size() * sizeof( T ) );
+			return true;
+		}
+		static bool read( std::string_view data, std::vector<T>* value )
+		{
+			if( data.size() % sizeof( T ) )
+				return false;
+			value->resize( data.size() / sizeof( T ) );
+			if( ! data.empty() )
+				std::memcpy( value->data(), data.data(), data.size() );
+			return true;
+		}
+	};
+
+} //namespace cinder
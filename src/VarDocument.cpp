@@ -0,0 +1,741 @@
+#include "VarDocument.h"
+#include "VarRegistry.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+#if defined( CINDER_MSW )
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+using namespace ci;
+
+namespace
+{
+	const char		SNAPSHOT_MAGIC[4] = { 'C', 'V', 'A', 'R' };
+	const uint32_t	SNAPSHOT_FORMAT = 1;
+
+	// snapshot layout: header, groups, values, fields, then the strings and binary values.
+	// Offsets are relative to the start of the strings.
+	struct SnapshotHeader {
+		char		magic[4];
+		uint32_t	format;
+		uint64_t	fileSize;
+		uint64_t	sourceSize;
+		int64_t		sourceTime;
+		uint32_t	groupCount, valueCount, fieldCount, reserved;
+	};
+
+	struct SnapshotGroup {
+		uint64_t	hash;
+		uint32_t	name, nameSize, firstValue, valueCount;
+	};
+
+	struct SnapshotValue {
+		uint64_t	hash;
+		uint32_t	group, name, nameSize, text, textSize, binary, binarySize, firstField, fieldCount;
+		uint8_t		isObject, binaryType, reserved[2];
+	};
+
+	struct SnapshotField {
+		uint32_t	key, keySize, value, valueSize;
+	};
+
+	void hashCombine(uint64_t & seed, uint64_t value)
+	{
+		seed ^= value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2);
+	}
+
+	template <class IndexT>
+	void sortIndex(IndexT & index)
+	{
+		std::sort(index.begin(), index.end(), [] (const auto & left, const auto & right)
+		{
+			return left.first < right.first;
+		});
+	}
+
+	template <class IndexT, class MatchT>
+	const uint32_t * findInIndex(const IndexT & index, uint64_t hash, MatchT && match)
+	{
+		auto it = std::lower_bound(index.begin(), index.end(), hash, [] (const auto & item, uint64_t h)
+		{
+			return item.first < h;
+		});
+		for(; it != index.end() && it->first == hash; ++it)
+		{
+			if(match(it->second))
+			{
+				return &it->second;
+			}
+		}
+		return nullptr;
+	}
+}
+
+class VarDocument::Parser {
+public:
+	Parser( VarDocument& doc )
+	: mDoc( doc ), mBegin( doc.mBuffer.data() ), mPos( doc.mBuffer.data() ), mEnd( doc.mBuffer.data() + doc.mBuffer.size() )
+	{}
+
+	void parseDocument()
+	{
+		// the unnamed group holds the top-level scalars
+		mDoc.mGroups.push_back( { std::string_view{}, 0, 0, 0 } );
+
+		expect( '{' );
+		if( ! tryConsume( '}' ) ) {
+			do {
+				const auto key = parseString();
+				expect( ':' );
+				skipWhitespace();
+				if( peek() == '{' )
+					parseGroup( key );
+				else if( peek() == '[' )
+					skipValue();
+				else
+					addValue( 0, key, parseScalar() );
+			} while( tryConsume( ',' ) );
+			expect( '}' );
+		}
+
+		skipWhitespace();
+		if( mPos != mEnd )
+			error( "unexpected content after the root object" );
+	}
+
+private:
+	void parseGroup( std::string_view name )
+	{
+		expect( '{' );
+		const uint32_t groupIndex = static_cast<uint32_t>( mDoc.mGroups.size() );
+		mDoc.mGroups.push_back( { name, static_cast<uint32_t>( mDoc.mValues.size() ), 0, 0 } );
+
+		if( tryConsume( '}' ) )
+			return;
+
+		do {
+			const auto key = parseString();
+			expect( ':' );
+			skipWhitespace();
+			if( peek() == '{' )
+				parseObjectValue( groupIndex, key );
+			else
+				addValue( groupIndex, key, peek() == '[' ? skipValue() : parseScalar() );
+		} while( tryConsume( ',' ) );
+		expect( '}' );
+	}
+
+	void parseObjectValue( uint32_t groupIndex, std::string_view name )
+	{
+		expect( '{' );
+		const uint32_t firstField = static_cast<uint32_t>( mDoc.mFields.size() );
+		uint64_t hash = VarRegistry::hash( "{" );
+
+		if( ! tryConsume( '}' ) ) {
+			do {
+				const auto key = parseString();
+				expect( ':' );
+				skipWhitespace();
+				if( peek() == '{' || peek() == '[' ) {
+					// deeper structures are not var values
+					skipValue();
+					continue;
+				}
+				const auto value = parseScalar();
+				mDoc.mFields.push_back( { key, value } );
+				hashCombine( hash, VarRegistry::hash( key ) );
+				hashCombine( hash, VarRegistry::hash( value ) );
+			} while( tryConsume( ',' ) );
+			expect( '}' );
+		}
+
+		Value value{};
+		value.name = name;
+		// fields are resolved to pointers once the parse is done
+		value.firstField = firstField;
+		value.fieldCount = static_cast<uint32_t>( mDoc.mFields.size() ) - firstField;
+		value.isObject = true;
+		value.hash = hash;
+		pushValue( groupIndex, value );
+	}
+
+	void addValue( uint32_t groupIndex, std::string_view name, std::string_view text )
+	{
+		Value value{};
+		value.name = name;
+		value.text = text;
+		value.fields = nullptr;
+		value.hash = VarRegistry::hash( text );
+		pushValue( groupIndex, value );
+	}
+
+	void pushValue( uint32_t groupIndex, Value& value )
+	{
+		auto& group = mDoc.mGroups[groupIndex];
+		value.group = group.name;
+
+		// top-level scalars may be interleaved with groups, keep every group contiguous
+		if( groupIndex == 0 ) {
+			mTopLevelValues.push_back( value );
+			return;
+		}
+
+		mDoc.mValues.push_back( value );
+		++group.valueCount;
+		hashCombine( group.hash, VarRegistry::hash( value.name ) );
+		hashCombine( group.hash, value.hash );
+	}
+
+public:
+	void finish()
+	{
+		auto& topLevel = mDoc.mGroups.front();
+		topLevel.firstValue = static_cast<uint32_t>( mDoc.mValues.size() );
+		for( auto& value : mTopLevelValues ) {
+			mDoc.mValues.push_back( value );
+			++topLevel.valueCount;
+			hashCombine( topLevel.hash, VarRegistry::hash( value.name ) );
+			hashCombine( topLevel.hash, value.hash );
+		}
+
+		for( auto& value : mDoc.mValues ) {
+			if( value.isObject )
+				value.fields = mDoc.mFields.data() + value.firstField;
+		}
+
+		mDoc.buildIndex();
+	}
+
+private:
+	//! Unescapes in place and returns a view of the string content.
+	std::string_view parseString()
+	{
+		expect( '"' );
+		char* out = mPos;
+		char* const begin = mPos;
+		while( true ) {
+			if( mPos == mEnd )
+				error( "unterminated string" );
+			char c = *mPos++;
+			if( c == '"' )
+				break;
+			if( c != '\\' ) {
+				*out++ = c;
+				continue;
+			}
+			if( mPos == mEnd )
+				error( "unterminated string" );
+			c = *mPos++;
+			switch( c ) {
+				case 'b': *out++ = '\b'; break;
+				case 'f': *out++ = '\f'; break;
+				case 'n': *out++ = '\n'; break;
+				case 'r': *out++ = '\r'; break;
+				case 't': *out++ = '\t'; break;
+				case 'u': out = writeUtf8( out, parseCodePoint() ); break;
+				default: *out++ = c; break;
+			}
+		}
+		return { begin, static_cast<size_t>( out - begin ) };
+	}
+
+	uint32_t parseHex4()
+	{
+		if( mEnd - mPos < 4 )
+			error( "invalid unicode escape" );
+		uint32_t result = 0;
+		for( int i = 0; i < 4; ++i ) {
+			const char c = *mPos++;
+			result <<= 4;
+			if( c >= '0' && c <= '9' )		result |= c - '0';
+			else if( c >= 'a' && c <= 'f' )	result |= c - 'a' + 10;
+			else if( c >= 'A' && c <= 'F' )	result |= c - 'A' + 10;
+			else error( "invalid unicode escape" );
+		}
+		return result;
+	}
+
+	uint32_t parseCodePoint()
+	{
+		uint32_t codePoint = parseHex4();
+		if( codePoint >= 0xD800 && codePoint <= 0xDBFF && mEnd - mPos >= 6 && mPos[0] == '\\' && mPos[1] == 'u' ) {
+			mPos += 2;
+			const uint32_t low = parseHex4();
+			codePoint = 0x10000 + ( ( codePoint - 0xD800 ) << 10 ) + ( low - 0xDC00 );
+		}
+		return codePoint;
+	}
+
+	// an escape sequence is always at least as long as its utf-8 encoding
+	static char* writeUtf8( char* out, uint32_t codePoint )
+	{
+		if( codePoint < 0x80 ) {
+			*out++ = static_cast<char>( codePoint );
+		}
+		else if( codePoint < 0x800 ) {
+			*out++ = static_cast<char>( 0xC0 | ( codePoint >> 6 ) );
+			*out++ = static_cast<char>( 0x80 | ( codePoint & 0x3F ) );
+		}
+		else if( codePoint < 0x10000 ) {
+			*out++ = static_cast<char>( 0xE0 | ( codePoint >> 12 ) );
+			*out++ = static_cast<char>( 0x80 | ( ( codePoint >> 6 ) & 0x3F ) );
+			*out++ = static_cast<char>( 0x80 | ( codePoint & 0x3F ) );
+		}
+		else {
+			*out++ = static_cast<char>( 0xF0 | ( codePoint >> 18 ) );
+			*out++ = static_cast<char>( 0x80 | ( ( codePoint >> 12 ) & 0x3F ) );
+			*out++ = static_cast<char>( 0x80 | ( ( codePoint >> 6 ) & 0x3F ) );
+			*out++ = static_cast<char>( 0x80 | ( codePoint & 0x3F ) );
+		}
+		return out;
+	}
+
+	//! Strings, numbers, booleans. null reads as an empty value.
+	std::string_view parseScalar()
+	{
+		skipWhitespace();
+		if( peek() == '"' )
+			return parseString();
+
+		const char* begin = mPos;
+		while( mPos != mEnd && ! isDelimiter( *mPos ) )
+			++mPos;
+		const std::string_view token{ begin, static_cast<size_t>( mPos - begin ) };
+		if( token.empty() )
+			error( "expected a value" );
+		return token == "null" ? std::string_view{} : token;
+	}
+
+	//! Skips an object or array and returns its raw text.
+	std::string_view skipValue()
+	{
+		skipWhitespace();
+		const char* begin = mPos;
+		if( peek() != '{' && peek() != '[' ) {
+			parseScalar();
+			return { begin, static_cast<size_t>( mPos - begin ) };
+		}
+
+		int depth = 0;
+		do {
+			if( mPos == mEnd )
+				error( "unterminated object or array" );
+			const char c = *mPos;
+			if( c == '"' ) {
+				parseString();
+				continue;
+			}
+			if( c == '{' || c == '[' )
+				++depth;
+			else if( c == '}' || c == ']' )
+				--depth;
+			++mPos;
+		} while( depth > 0 );
+		return { begin, static_cast<size_t>( mPos - begin ) };
+	}
+
+	static bool isDelimiter( char c )
+	{
+		return c == ',' || c == '}' || c == ']' || c == ':' || c == ' ' || c == '\t' || c == '\n' || c == '\r';
+	}
+
+	void skipWhitespace()
+	{
+		while( mPos != mEnd && ( *mPos == ' ' || *mPos == '\t' || *mPos == '\n' || *mPos == '\r' ) )
+			++mPos;
+	}
+
+	char peek() const
+	{
+		return mPos == mEnd ? '\0' : *mPos;
+	}
+
+	bool tryConsume( char c )
+	{
+		skipWhitespace();
+		if( peek() != c )
+			return false;
+		++mPos;
+		return true;
+	}
+
+	void expect( char c )
+	{
+		if( ! tryConsume( c ) )
+			error( std::string( "expected '" ) + c + "'" );
+	}
+
+	[[noreturn]] void error( const std::string& message ) const
+	{
+		const auto line = 1 + std::count( static_cast<const char*>( mBegin ), static_cast<const char*>( mPos ), '\n' );
+		throw JsonTree::ExcJsonParserError( "line " + std::to_string( line ) + ": " + message );
+	}
+
+	VarDocument&		mDoc;
+	const char* const	mBegin;
+	char*				mPos;
+	char* const			mEnd;
+	std::vector<Value>	mTopLevelValues;
+};
+
+std::unique_ptr<VarDocument> VarDocument::parse( std::vector<char> buffer )
+{
+	std::unique_ptr<VarDocument> doc{ new VarDocument };
+	doc->mBuffer = std::move( buffer );
+
+	Parser parser{ *doc };
+	parser.parseDocument();
+	parser.finish();
+	return doc;
+}
+
+std::unique_ptr<VarDocument> VarDocument::load( const fs::path& path )
+{
+	// taken before reading: a change during the read makes the snapshot stale, never wrong
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if( ! getFileState( path, &sourceSize, &sourceTime ) )
+		return nullptr;
+
+	const auto startTime = std::chrono::steady_clock::now();
+	std::ifstream file( path, std::ios::binary | std::ios::ate );
+	if( ! file )
+		return nullptr;
+
+	std::vector<char> buffer( static_cast<size_t>( file.tellg() ) );
+	file.seekg( 0 );
+	if( ! file.read( buffer.data(), buffer.size() ) )
+		return nullptr;
+
+	const auto readTime = std::chrono::steady_clock::now();
+	auto doc = parse( std::move( buffer ) );
+	doc->mSourcePath = path;
+	doc->mSourceSize = sourceSize;
+	doc->mSourceTime = sourceTime;
+	doc->mReadTime = std::chrono::duration<double>( readTime - startTime ).count();
+	doc->mParseTime = std::chrono::duration<double>( std::chrono::steady_clock::now() - readTime ).count();
+	return doc;
+}
+
+VarDocument::~VarDocument()
+{
+}
+
+bool VarDocument::getFileState( const fs::path& path, uint64_t* size, int64_t* time )
+{
+	std::error_code error;
+	const auto fileSize = fs::file_size( path, error );
+	if( error )
+		return false;
+	const auto fileTime = fs::last_write_time( path, error );
+	if( error )
+		return false;
+	*size = fileSize;
+	*time = static_cast<int64_t>( fileTime.time_since_epoch().count() );
+	return true;
+}
+
+void VarDocument::buildIndex()
+{
+	mGroupIndex.clear();
+	mValueIndex.clear();
+	for( uint32_t i = 0; i < mGroups.size(); ++i )
+		mGroupIndex.emplace_back( VarRegistry::hash( mGroups[i].name ), i );
+	for( uint32_t i = 0; i < mValues.size(); ++i )
+		mValueIndex.emplace_back( VarRegistry::hash( mValues[i].group, mValues[i].name ), i );
+	sortIndex( mGroupIndex );
+	sortIndex( mValueIndex );
+}
+
+class VarDocument::MappedFile {
+public:
+	//! Maps \a path read-only. Returns null on failure.
+	static std::unique_ptr<MappedFile> open( const fs::path& path )
+	{
+		std::unique_ptr<MappedFile> file{ new MappedFile };
+#if defined( CINDER_MSW )
+		file->mFile = ::CreateFileW( path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+		if( file->mFile == INVALID_HANDLE_VALUE )
+			return nullptr;
+		LARGE_INTEGER size;
+		if( ! ::GetFileSizeEx( file->mFile, &size ) || size.QuadPart == 0 )
+			return nullptr;
+		file->mMapping = ::CreateFileMappingW( file->mFile, nullptr, PAGE_READONLY, 0, 0, nullptr );
+		if( ! file->mMapping )
+			return nullptr;
+		file->mData = static_cast<const char*>( ::MapViewOfFile( file->mMapping, FILE_MAP_READ, 0, 0, 0 ) );
+		file->mSize = static_cast<size_t>( size.QuadPart );
+#else
+		file->mFd = ::open( path.c_str(), O_RDONLY );
+		if( file->mFd < 0 )
+			return nullptr;
+		struct stat info;
+		if( ::fstat( file->mFd, &info ) != 0 || info.st_size == 0 )
+			return nullptr;
+		void* data = ::mmap( nullptr, static_cast<size_t>( info.st_size ), PROT_READ, MAP_PRIVATE, file->mFd, 0 );
+		if( data == MAP_FAILED )
+			return nullptr;
+		file->mData = static_cast<const char*>( data );
+		file->mSize = static_cast<size_t>( info.st_size );
+#endif
+		return file->mData ? std::move( file ) : nullptr;
+	}
+
+	~MappedFile()
+	{
+#if defined( CINDER_MSW )
+		if( mData )
+			::UnmapViewOfFile( mData );
+		if( mMapping )
+			::CloseHandle( mMapping );
+		if( mFile != INVALID_HANDLE_VALUE )
+			::CloseHandle( mFile );
+#else
+		if( mData )
+			::munmap( const_cast<char*>( mData ), mSize );
+		if( mFd >= 0 )
+			::close( mFd );
+#endif
+	}
+
+	const char*	data() const { return mData; }
+	size_t		size() const { return mSize; }
+
+private:
+	MappedFile() = default;
+
+#if defined( CINDER_MSW )
+	HANDLE		mFile = INVALID_HANDLE_VALUE;
+	HANDLE		mMapping = nullptr;
+#else
+	int			mFd = -1;
+#endif
+	const char*	mData = nullptr;
+	size_t		mSize = 0;
+};
+
+fs::path VarDocument::getSnapshotPath( const fs::path& jsonPath )
+{
+	auto path = jsonPath;
+	path += ".cache";
+	return path;
+}
+
+std::unique_ptr<VarDocument> VarDocument::loadSnapshot( const fs::path& jsonPath )
+{
+	const auto startTime = std::chrono::steady_clock::now();
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	if( ! getFileState( jsonPath, &sourceSize, &sourceTime ) )
+		return nullptr;
+
+	auto mapping = MappedFile::open( getSnapshotPath( jsonPath ) );
+	if( ! mapping || mapping->size() < sizeof( SnapshotHeader ) )
+		return nullptr;
+
+	const char* data = mapping->data();
+	const auto& header = *reinterpret_cast<const SnapshotHeader*>( data );
+	if( std::memcmp( header.magic, SNAPSHOT_MAGIC, sizeof( SNAPSHOT_MAGIC ) ) != 0
+		|| header.format != SNAPSHOT_FORMAT
+		|| header.fileSize != mapping->size()
+		|| header.sourceSize != sourceSize
+		|| header.sourceTime != sourceTime )
+		return nullptr;
+
+	const size_t tablesSize = sizeof( SnapshotHeader )
+		+ size_t( header.groupCount ) * sizeof( SnapshotGroup )
+		+ size_t( header.valueCount ) * sizeof( SnapshotValue )
+		+ size_t( header.fieldCount ) * sizeof( SnapshotField );
+	if( tablesSize > mapping->size() )
+		return nullptr;
+
+	const auto groups = reinterpret_cast<const SnapshotGroup*>( data + sizeof( SnapshotHeader ) );
+	const auto values = reinterpret_cast<const SnapshotValue*>( groups + header.groupCount );
+	const auto fields = reinterpret_cast<const SnapshotField*>( values + header.valueCount );
+	const char* blob = data + tablesSize;
+	const size_t blobSize = mapping->size() - tablesSize;
+
+	bool valid = true;
+	auto view = [&] ( uint32_t offset, uint32_t size ) -> std::string_view {
+		if( size_t( offset ) + size > blobSize ) {
+			valid = false;
+			return {};
+		}
+		return { blob + offset, size };
+	};
+
+	std::unique_ptr<VarDocument> doc{ new VarDocument };
+	doc->mSourcePath = jsonPath;
+	doc->mSourceSize = sourceSize;
+	doc->mSourceTime = sourceTime;
+
+	doc->mGroups.reserve( header.groupCount );
+	for( uint32_t i = 0; i < header.groupCount; ++i ) {
+		const auto& group = groups[i];
+		if( size_t( group.firstValue ) + group.valueCount > header.valueCount )
+			return nullptr;
+		doc->mGroups.push_back( { view( group.name, group.nameSize ), group.firstValue, group.valueCount, group.hash } );
+	}
+
+	doc->mFields.reserve( header.fieldCount );
+	for( uint32_t i = 0; i < header.fieldCount; ++i )
+		doc->mFields.push_back( { view( fields[i].key, fields[i].keySize ), view( fields[i].value, fields[i].valueSize ) } );
+
+	doc->mValues.reserve( header.valueCount );
+	for( uint32_t i = 0; i < header.valueCount; ++i ) {
+		const auto& snapshotValue = values[i];
+		if( snapshotValue.group >= header.groupCount || size_t( snapshotValue.firstField ) + snapshotValue.fieldCount > header.fieldCount )
+			return nullptr;
+
+		Value value{};
+		value.group = doc->mGroups[snapshotValue.group].name;
+		value.name = view( snapshotValue.name, snapshotValue.nameSize );
+		value.text = view( snapshotValue.text, snapshotValue.textSize );
+		value.firstField = snapshotValue.firstField;
+		value.fieldCount = snapshotValue.fieldCount;
+		value.isObject = snapshotValue.isObject != 0;
+		value.fields = value.isObject ? doc->mFields.data() + value.firstField : nullptr;
+		value.hash = snapshotValue.hash;
+		value.binaryType = static_cast<VarType>( snapshotValue.binaryType );
+		value.binary = view( snapshotValue.binary, snapshotValue.binarySize );
+		doc->mValues.push_back( value );
+	}
+
+	if( ! valid )
+		return nullptr;
+
+	doc->mMapping = std::move( mapping );
+	doc->buildIndex();
+	doc->mReadTime = std::chrono::duration<double>( std::chrono::steady_clock::now() - startTime ).count();
+	return doc;
+}
+
+bool VarDocument::writeSnapshot( const std::vector<BinaryValue>& binaryValues ) const
+{
+	if( mSourcePath.empty() || isSnapshot() )
+		return false;
+
+	std::vector<char> blob;
+	auto append = [&blob] ( const char* data, size_t size ) {
+		const uint32_t offset = static_cast<uint32_t>( blob.size() );
+		blob.insert( blob.end(), data, data + size );
+		return offset;
+	};
+
+	std::vector<SnapshotGroup> groups;
+	groups.reserve( mGroups.size() );
+	for( const auto& group : mGroups ) {
+		SnapshotGroup snapshotGroup{};
+		snapshotGroup.hash = group.hash;
+		snapshotGroup.name = append( group.name.data(), group.name.size() );
+		snapshotGroup.nameSize = static_cast<uint32_t>( group.name.size() );
+		snapshotGroup.firstValue = group.firstValue;
+		snapshotGroup.valueCount = group.valueCount;
+		groups.push_back( snapshotGroup );
+	}
+
+	std::vector<SnapshotField> fields;
+	fields.reserve( mFields.size() );
+	for( const auto& field : mFields ) {
+		SnapshotField snapshotField{};
+		snapshotField.key = append( field.key.data(), field.key.size() );
+		snapshotField.keySize = static_cast<uint32_t>( field.key.size() );
+		snapshotField.value = append( field.value.data(), field.value.size() );
+		snapshotField.valueSize = static_cast<uint32_t>( field.value.size() );
+		fields.push_back( snapshotField );
+	}
+
+	std::vector<SnapshotValue> values( mValues.size() );
+	for( uint32_t i = 0; i < mValues.size(); ++i ) {
+		const auto& value = mValues[i];
+		auto& snapshotValue = values[i];
+		snapshotValue.hash = value.hash;
+		snapshotValue.name = append( value.name.data(), value.name.size() );
+		snapshotValue.nameSize = static_cast<uint32_t>( value.name.size() );
+		snapshotValue.text = append( value.text.data(), value.text.size() );
+		snapshotValue.textSize = static_cast<uint32_t>( value.text.size() );
+		snapshotValue.firstField = value.firstField;
+		snapshotValue.fieldCount = value.fieldCount;
+		snapshotValue.isObject = value.isObject ? 1 : 0;
+	}
+
+	for( uint32_t g = 0; g < mGroups.size(); ++g ) {
+		for( uint32_t i = mGroups[g].firstValue; i < mGroups[g].firstValue + mGroups[g].valueCount; ++i )
+			values[i].group = g;
+	}
+
+	for( const auto& binaryValue : binaryValues ) {
+		auto& snapshotValue = values[binaryValue.value - mValues.data()];
+		snapshotValue.binaryType = static_cast<uint8_t>( binaryValue.type );
+		snapshotValue.binary = append( binaryValue.data.data(), binaryValue.data.size() );
+		snapshotValue.binarySize = static_cast<uint32_t>( binaryValue.data.size() );
+	}
+
+	SnapshotHeader header{};
+	std::memcpy( header.magic, SNAPSHOT_MAGIC, sizeof( SNAPSHOT_MAGIC ) );
+	header.format = SNAPSHOT_FORMAT;
+	header.sourceSize = mSourceSize;
+	header.sourceTime = mSourceTime;
+	header.groupCount = static_cast<uint32_t>( groups.size() );
+	header.valueCount = static_cast<uint32_t>( values.size() );
+	header.fieldCount = static_cast<uint32_t>( fields.size() );
+	header.fileSize = sizeof( header )
+		+ groups.size() * sizeof( SnapshotGroup )
+		+ values.size() * sizeof( SnapshotValue )
+		+ fields.size() * sizeof( SnapshotField )
+		+ blob.size();
+
+	// write aside then rename, so a reader never maps a partial snapshot
+	const auto path = getSnapshotPath( mSourcePath );
+	auto tempPath = path;
+	tempPath += ".tmp";
+	{
+		std::ofstream file( tempPath, std::ios::binary | std::ios::trunc );
+		file.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+		file.write( reinterpret_cast<const char*>( groups.data() ), groups.size() * sizeof( SnapshotGroup ) );
+		file.write( reinterpret_cast<const char*>( values.data() ), values.size() * sizeof( SnapshotValue ) );
+		file.write( reinterpret_cast<const char*>( fields.data() ), fields.size() * sizeof( SnapshotField ) );
+		file.write( blob.data(), blob.size() );
+		if( ! file )
+			return false;
+	}
+
+	std::error_code error;
+	fs::rename( tempPath, path, error );
+	return ! error;
+}
+
+const VarDocument::Group* VarDocument::findGroup( std::string_view name ) const
+{
+	const auto index = findInIndex( mGroupIndex, VarRegistry::hash( name ), [&] ( uint32_t i )
+	{
+		return mGroups[i].name == name;
+	});
+	return index ? &mGroups[*index] : nullptr;
+}
+
+const VarDocument::Value* VarDocument::find( std::string_view group, std::string_view name ) const
+{
+	const auto index = findInIndex( mValueIndex, VarRegistry::hash( group, name ), [&] ( uint32_t i )
+	{
+		return mValues[i].group == group && mValues[i].name == name;
+	});
+	return index ? &mValues[*index] : nullptr;
+}
+
+std::string_view VarDocument::Value::field( std::string_view key ) const
+{
+	for( const auto& f : *this ) {
+		if( f.key == key )
+			return f.value;
+	}
+	throw JsonTree::ExcJsonParserError( "missing \"" + std::string( key ) + "\" in " + std::string( group ) + "." + std::string( name ) );
+}
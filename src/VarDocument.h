@@ -0,0 +1,123 @@
+#pragma once
+
+#include "cinder/Cinder.h"
+#include "cinder/JsonTree.h"
+
+#include "VarBinary.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace cinder {
+
+	/**
+	 * A var file read in a single pass into a flat list of values, without building a tree.
+	 *
+	 * The expected layout is the one written by JsonBag::save:
+	 * { "group" : { "name" : "value", "vec" : { "x" : "1", ... } }, "version" : 1 }
+	 *
+	 * Top-level scalars (e.g. "version") are stored in the unnamed group "". Keys and
+	 * values are views into the document's own buffer, where strings are unescaped in place.
+	 * Groups and values are looked up by hash in constant time.
+	 *
+	 * A document can also be saved as a binary snapshot, next to its JSON file, which adds
+	 * the typed binary form of the values. Loading a snapshot memory-maps it and does not
+	 * parse anything.
+	 */
+	class VarDocument : public ci::Noncopyable {
+	public:
+		struct Field {
+			std::string_view	key;
+			std::string_view	value;
+		};
+
+		//! A var value: a scalar, or an object of scalar fields (vectors, colors, dynamic objects).
+		struct Value {
+			std::string_view	group;
+			std::string_view	name;
+			std::string_view	text;		// empty for objects
+			const Field*		fields;
+			uint32_t			firstField, fieldCount;
+			bool				isObject;
+			uint64_t			hash;		// of the value content, not of its formatting
+			VarType				binaryType;	// Unknown when the value has no binary form
+			std::string_view	binary;
+
+			//! Throws JsonTree::ExcJsonParserError when \a key is missing.
+			std::string_view field( std::string_view key ) const;
+			const Field* begin() const { return fields; }
+			const Field* end() const { return fields + fieldCount; }
+		};
+
+		struct Group {
+			std::string_view	name;
+			uint32_t			firstValue, valueCount;
+			uint64_t			hash;
+		};
+
+		//! Throws JsonTree::ExcJsonParserError on invalid content.
+		static std::unique_ptr<VarDocument> parse( std::vector<char> buffer );
+		//! Returns null when the file cannot be read. Throws JsonTree::ExcJsonParserError on invalid content.
+		static std::unique_ptr<VarDocument> load( const fs::path& path );
+
+		//! Typed binary form of a value, written to the snapshot.
+		struct BinaryValue {
+			const Value*		value;
+			VarType				type;
+			std::vector<char>	data;
+		};
+
+		//! Size and modification time of \a path, as recorded by load(). Returns false when the file cannot be read.
+		static bool getFileState( const fs::path& path, uint64_t* size, int64_t* time );
+
+		static fs::path getSnapshotPath( const fs::path& jsonPath );
+		//! Returns null when there is no snapshot of \a jsonPath, or when the JSON file changed since it was written.
+		static std::unique_ptr<VarDocument> loadSnapshot( const fs::path& jsonPath );
+		//! Writes the snapshot of a document loaded from a JSON file. Returns false on failure.
+		bool writeSnapshot( const std::vector<BinaryValue>& binaryValues ) const;
+
+		~VarDocument();
+
+		bool isSnapshot() const { return mMapping != nullptr; }
+		const fs::path& getSourcePath() const { return mSourcePath; }
+
+		const std::vector<Group>& getGroups() const { return mGroups; }
+		const Group* findGroup( std::string_view name ) const;
+
+		const Value* find( std::string_view group, std::string_view name ) const;
+		const Value* begin( const Group& group ) const { return mValues.data() + group.firstValue; }
+		const Value* end( const Group& group ) const { return begin( group ) + group.valueCount; }
+
+		size_t getSize() const { return mBuffer.size(); }
+		//! Size and modification time (in fs::file_time_type ticks) of the JSON file the document was read from.
+		uint64_t getSourceSize() const { return mSourceSize; }
+		int64_t getSourceTime() const { return mSourceTime; }
+		//! Seconds spent reading and parsing the file. Mapping a snapshot counts as reading it.
+		double getReadTime() const { return mReadTime; }
+		double getParseTime() const { return mParseTime; }
+		const std::vector<Value>& getValues() const { return mValues; }
+
+	private:
+		VarDocument() = default;
+
+		class Parser;
+		class MappedFile;
+
+		void buildIndex();
+
+		std::vector<char>		mBuffer;
+		std::unique_ptr<MappedFile>	mMapping;
+		// identifies the state of the JSON file the document was read from
+		fs::path				mSourcePath;
+		uint64_t				mSourceSize = 0;
+		int64_t					mSourceTime = 0;
+		double					mReadTime = 0.0, mParseTime = 0.0;
+		std::vector<Group>		mGroups;
+		std::vector<Value>		mValues;
+		std::vector<Field>		mFields;
+		// (hash, index) sorted by hash
+		std::vector<std::pair<uint64_t, uint32_t>>	mGroupIndex, mValueIndex;
+	};
+
+} //namespace cinder
@@ -0,0 +1,139 @@
+#pragma once
+
+#include "cinder/Cinder.h"
+
+#include "VarBinary.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+namespace cinder {
+
+	/**
+	 * Binary log of var changes, see JsonBag::startRecording() and JsonBag::startReplay().
+	 *
+	 * An 8-byte header, then packed records in native byte order: kind (u8), type (u8), handle (u32),
+	 * time in microseconds since the start of the recording (u64), data size (u32) and data. A var is
+	 * defined once with its "group.name" as data, then each change holds the binary form of its value
+	 * (see BinaryCodec). Frame records mark the end of the changes of a JsonBag::update().
+	 */
+	struct VarLog {
+		enum class Kind : uint8_t { Define, Value, Frame };
+
+		struct Record {
+			Kind				kind;
+			VarType				type;
+			uint32_t			handle;
+			uint64_t			time;
+			std::string_view	data;
+		};
+
+		static const size_t HEADER_SIZE = 8;
+		static const size_t RECORD_HEADER_SIZE = 1 + 1 + 4 + 8 + 4;
+
+		static void appendHeader( std::vector<char>* out )
+		{
+			const uint32_t format = 1;
+			out->insert( out->end(), MAGIC, MAGIC + sizeof( MAGIC ) );
+			append( out, format );
+		}
+
+		//! Appends the header of a record, followed by \a size bytes of \a data when given. Returns the offset
+		//! of the size field, to write the data right after and then fix the size with setSize().
+		static size_t appendRecord( std::vector<char>* out, Kind kind, VarType type, uint32_t handle, uint64_t time, const char* data = nullptr, uint32_t size = 0 )
+		{
+			append( out, kind );
+			append( out, type );
+			append( out, handle );
+			append( out, time );
+			const size_t sizeOffset = out->size();
+			append( out, size );
+			if( data )
+				out->insert( out->end(), data, data + size );
+			return sizeOffset;
+		}
+
+		static void setSize( std::vector<char>* out, size_t sizeOffset, uint32_t size )
+		{
+			std::memcpy( out->data() + sizeOffset, &size, sizeof( size ) );
+		}
+
+		//! Reads a whole log, records point into the log. Returns null when it cannot be read or is not a log.
+		class Reader {
+		public:
+			static std::unique_ptr<Reader> open( const fs::path& path )
+			{
+				std::ifstream file( path, std::ios::binary | std::ios::ate );
+				if( ! file )
+					return nullptr;
+
+				std::unique_ptr<Reader> reader{ new Reader };
+				reader->mBuffer.resize( static_cast<size_t>( file.tellg() ) );
+				file.seekg( 0 );
+				if( ! file.read( reader->mBuffer.data(), reader->mBuffer.size() )
+					|| reader->mBuffer.size() < HEADER_SIZE
+					|| std::memcmp( reader->mBuffer.data(), MAGIC, sizeof( MAGIC ) ) != 0 )
+					return nullptr;
+
+				reader->mPosition = HEADER_SIZE;
+				reader->decode();
+				return reader;
+			}
+
+			//! The next record, null at the end of the log or on a truncated record.
+			const Record* peek() const { return mHasRecord ? &mRecord : nullptr; }
+			void pop() { decode(); }
+
+		private:
+			Reader() = default;
+
+			void decode()
+			{
+				mHasRecord = false;
+				if( mBuffer.size() - mPosition < RECORD_HEADER_SIZE )
+					return;
+
+				const char* it = mBuffer.data() + mPosition;
+				uint32_t size;
+				read( &it, &mRecord.kind );
+				read( &it, &mRecord.type );
+				read( &it, &mRecord.handle );
+				read( &it, &mRecord.time );
+				read( &it, &size );
+				if( mBuffer.size() - mPosition - RECORD_HEADER_SIZE < size )
+					return; // cut by a crash
+
+				mRecord.data = { it, size };
+				mPosition += RECORD_HEADER_SIZE + size;
+				mHasRecord = true;
+			}
+
+			template<typename T>
+			static void read( const char** it, T* value )
+			{
+				std::memcpy( value, *it, sizeof( T ) );
+				*it += sizeof( T );
+			}
+
+			std::vector<char>	mBuffer;
+			size_t				mPosition = 0;
+			Record				mRecord;
+			bool				mHasRecord = false;
+		};
+
+	private:
+		static constexpr char MAGIC[4] = { 'C', 'V', 'L', 'G' };
+
+		template<typename T>
+		static void append( std::vector<char>* out, const T& value )
+		{
+			const char* bytes = reinterpret_cast<const char*>( &value );
+			out->insert( out->end(), bytes, bytes + sizeof( T ) );
+		}
+	};
+
+} //namespace cinder
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cinder {
+
+	/**
+	 * Call count and durations of each update callback connected with VarBase::addUpdateFn(), to find
+	 * the listeners that stall a frame after a reload.
+	 *
+	 * Only used when the library is compiled with VAR_PROFILE_LISTENERS defined. Otherwise the callbacks
+	 * are connected as is and the profiler stays empty.
+	 */
+	class VarListenerProfiler {
+	public:
+		struct Listener {
+			std::string	groupName, name;	// of the var, set on the first call
+			size_t		index = 0;			// connection order among the var's callbacks
+			uint64_t	calls = 0;
+			double		totalTime = 0.0, maxTime = 0.0;	// seconds
+		};
+
+		static VarListenerProfiler& instance()
+		{
+			static VarListenerProfiler profiler;
+			return profiler;
+		}
+
+		//! Wraps \a updateFn so that its calls are recorded.
+		template<typename Var>
+		std::function<void()> wrap( const Var* var, size_t index, const std::function<void()>& updateFn )
+		{
+			auto listener = std::make_shared<Listener>();
+			listener->index = index;
+			{
+				std::lock_guard<std::mutex> lock( mMutex );
+				mListeners.push_back( listener );
+			}
+			return [this, var, listener, updateFn] {
+				const auto startTime = std::chrono::steady_clock::now();
+				updateFn();
+				const double time = std::chrono::duration<double>( std::chrono::steady_clock::now() - startTime ).count();
+
+				std::lock_guard<std::mutex> lock( mMutex );
+				if( listener->calls++ == 0 ) {
+					listener->groupName = var->getGroupName();
+					listener->name = var->getName();
+				}
+				listener->totalTime += time;
+				listener->maxTime = std::max( listener->maxTime, time );
+			};
+		}
+
+		//! The \a count listeners with the highest cumulative time.
+		std::vector<Listener> getSlowest( size_t count ) const
+		{
+			std::vector<Listener> listeners;
+			{
+				std::lock_guard<std::mutex> lock( mMutex );
+				for( const auto& listener : mListeners ) {
+					if( listener->calls )
+						listeners.push_back( *listener );
+				}
+			}
+			std::sort( listeners.begin(), listeners.end(), [] ( const Listener& a, const Listener& b ) { return a.totalTime > b.totalTime; } );
+			listeners.resize( std::min( count, listeners.size() ) );
+			return listeners;
+		}
+
+		//! One line per listener of getSlowest(), e.g. for CI_LOG_I.
+		std::string dumpSlowest( size_t count ) const
+		{
+			std::string text;
+			char line[256];
+			for( const auto& listener : getSlowest( count ) ) {
+				std::snprintf( line, sizeof( line ), "%s.%s #%zu: %llu calls, %.3f ms total, %.3f ms max\n",
+					listener.groupName.c_str(), listener.name.c_str(), listener.index,
+					static_cast<unsigned long long>( listener.calls ), listener.totalTime * 1000.0, listener.maxTime * 1000.0 );
+				text += line;
+			}
+			return text;
+		}
+
+		//! Clears the counters, and forgets the listeners that were disconnected.
+		void reset()
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			mListeners.erase( std::remove_if( mListeners.begin(), mListeners.end(), [] ( const std::shared_ptr<Listener>& listener ) {
+				return listener.use_count() == 1;
+			} ), mListeners.end() );
+			for( auto& listener : mListeners ) {
+				listener->calls = 0;
+				listener->totalTime = listener->maxTime = 0.0;
+			}
+		}
+
+	private:
+		mutable std::mutex						mMutex;
+		std::vector<std::shared_ptr<Listener>>	mListeners;
+	};
+
+} //namespace cinder
@@ -0,0 +1,189 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cinder {
+
+	class VarBase;
+
+	/**
+	 * A flat open-addressing index of the vars, keyed by their "group.name" full name.
+	 *
+	 * Names are hashed once on insertion; lookups take a std::string_view and never
+	 * allocate. The registry is not thread-safe: JsonBag guards it with its items mutex.
+	 */
+	class VarRegistry {
+	public:
+		static constexpr char SEPARATOR = '.';
+		//! A slot handle of nothing registered, ignored by eraseAt().
+		static constexpr size_t NO_SLOT = size_t( -1 );
+
+		//! 64-bit FNV-1a. hash( "group.name" ) == hash( "group", "name" ).
+		static uint64_t hash( std::string_view text, uint64_t seed = FNV_OFFSET_BASIS )
+		{
+			for( const char c : text ) {
+				seed ^= static_cast<unsigned char>( c );
+				seed *= FNV_PRIME;
+			}
+			return seed;
+		}
+		static uint64_t hash( std::string_view groupName, std::string_view name )
+		{
+			return hash( name, hash( std::string_view{ &SEPARATOR, 1 }, hash( groupName ) ) );
+		}
+
+		VarRegistry()
+		: mSlots( MIN_CAPACITY ), mSize( 0 ), mTombstones( 0 )
+		{}
+
+		//! Returns false if \a fullName is already registered. The slot index is written to
+		//! \a slotHandle, and kept up to date when the table grows, for eraseAt().
+		bool insert( std::string_view groupName, std::string_view name, VarBase* var, size_t* slotHandle = nullptr )
+		{
+			const uint64_t h = hash( groupName, name );
+			std::string fullName;
+			fullName.reserve( groupName.size() + 1 + name.size() );
+			fullName.append( groupName ).append( 1, SEPARATOR ).append( name );
+			if( findSlot( h, fullName ) != NOT_FOUND )
+				return false;
+
+			if( ( mSize + mTombstones + 1 ) * 2 > mSlots.size() )
+				rehash( ( mSize + 1 ) * 4 );
+
+			const size_t index = findFreeSlot( h );
+			Slot& slot = mSlots[index];
+			if( slot.tombstone )
+				--mTombstones;
+			slot.hash = h;
+			slot.var = var;
+			slot.tombstone = false;
+			slot.name = std::move( fullName );
+			slot.handle = slotHandle;
+			if( slotHandle )
+				*slotHandle = index;
+			++mSize;
+			return true;
+		}
+
+		VarBase* find( std::string_view fullName ) const
+		{
+			const size_t index = findSlot( hash( fullName ), fullName );
+			return index == NOT_FOUND ? nullptr : mSlots[index].var;
+		}
+
+		VarBase* find( std::string_view groupName, std::string_view name ) const
+		{
+			const uint64_t h = hash( groupName, name );
+			for( size_t i = h & mask(); ; i = ( i + 1 ) & mask() ) {
+				const Slot& slot = mSlots[i];
+				if( isEmpty( slot ) )
+					return nullptr;
+				if( slot.var && slot.hash == h && matches( slot.name, groupName, name ) )
+					return slot.var;
+			}
+		}
+
+		bool erase( std::string_view groupName, std::string_view name )
+		{
+			const uint64_t h = hash( groupName, name );
+			for( size_t i = h & mask(); ; i = ( i + 1 ) & mask() ) {
+				Slot& slot = mSlots[i];
+				if( isEmpty( slot ) )
+					return false;
+				if( slot.var && slot.hash == h && matches( slot.name, groupName, name ) ) {
+					eraseAt( i );
+					return true;
+				}
+			}
+		}
+
+		//! Constant time removal from the slot index given by insert().
+		void eraseAt( size_t index )
+		{
+			if( index == NO_SLOT )
+				return;
+			Slot& slot = mSlots[index];
+			if( ! slot.var )
+				return;
+
+			slot.var = nullptr;
+			slot.tombstone = true;
+			slot.handle = nullptr;
+			slot.name.clear();
+			--mSize;
+			++mTombstones;
+		}
+
+		size_t size() const { return mSize; }
+		bool empty() const { return mSize == 0; }
+
+	private:
+		struct Slot {
+			uint64_t	hash = 0;
+			VarBase*	var = nullptr;
+			bool		tombstone = false;
+			std::string	name;
+			size_t*		handle = nullptr;
+		};
+
+		static constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ULL;
+		static constexpr uint64_t FNV_PRIME = 1099511628211ULL;
+		static constexpr size_t MIN_CAPACITY = 64;
+		static constexpr size_t NOT_FOUND = size_t( -1 );
+
+		static bool isEmpty( const Slot& slot ) { return ! slot.var && ! slot.tombstone; }
+		static bool matches( const std::string& fullName, std::string_view groupName, std::string_view name )
+		{
+			return fullName.size() == groupName.size() + 1 + name.size()
+				&& fullName.compare( 0, groupName.size(), groupName ) == 0
+				&& fullName.compare( groupName.size() + 1, name.size(), name ) == 0;
+		}
+
+		size_t mask() const { return mSlots.size() - 1; }
+
+		size_t findSlot( uint64_t h, std::string_view fullName ) const
+		{
+			for( size_t i = h & mask(); ; i = ( i + 1 ) & mask() ) {
+				const Slot& slot = mSlots[i];
+				if( isEmpty( slot ) )
+					return NOT_FOUND;
+				if( slot.var && slot.hash == h && slot.name == fullName )
+					return i;
+			}
+		}
+
+		size_t findFreeSlot( uint64_t h ) const
+		{
+			size_t i = h & mask();
+			while( mSlots[i].var )
+				i = ( i + 1 ) & mask();
+			return i;
+		}
+
+		void rehash( size_t minCapacity )
+		{
+			size_t capacity = MIN_CAPACITY;
+			while( capacity < minCapacity )
+				capacity *= 2;
+
+			std::vector<Slot> slots( capacity );
+			std::swap( slots, mSlots );
+			mTombstones = 0;
+			for( auto& slot : slots ) {
+				if( slot.var ) {
+					const size_t index = findFreeSlot( slot.hash );
+					if( slot.handle )
+						*slot.handle = index;
+					mSlots[index] = std::move( slot );
+				}
+			}
+		}
+
+		std::vector<Slot>	mSlots;
+		size_t				mSize, mTombstones;
+	};
+
+} //namespace cinder
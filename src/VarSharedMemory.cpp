@@ -0,0 +1,253 @@
+#include "VarSharedMemory.h"
+
+#include "cinder/Log.h"
+
+#include <cerrno>
+#include <cstring>
+
+#if ! defined( CINDER_MSW )
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+using namespace ci;
+
+namespace
+{
+	const char		SHARED_MEMORY_MAGIC[4] = { 'C', 'V', 'S', 'M' };
+	const uint32_t	SHARED_MEMORY_FORMAT = 1;
+
+	size_t alignValue(size_t offset)
+	{
+		return (offset + 7) & ~size_t(7);
+	}
+}
+
+struct VarSharedMemory::Header {
+	char					magic[4];
+	uint32_t				format;
+	uint32_t				entryCount;
+	uint32_t				reserved;
+	uint64_t				size;
+	std::atomic<uint32_t>	stale;
+	uint32_t				reserved2;
+};
+
+struct VarSharedMemory::Entry {
+	uint64_t				nameHash;
+	uint32_t				offset, size;	// offset from the start of the values
+	uint32_t				type;
+	std::atomic<uint32_t>	sequence;		// odd while the value is written
+};
+
+static_assert( std::atomic<uint32_t>::is_always_lock_free, "shared between processes" );
+
+VarSharedMemory::Entry* VarSharedMemory::entries() const
+{
+	return reinterpret_cast<Entry*>( mData + sizeof( Header ) );
+}
+
+char* VarSharedMemory::values() const
+{
+	return mData + alignValue( sizeof( Header ) + header()->entryCount * sizeof( Entry ) );
+}
+
+size_t VarSharedMemory::getEntryCount() const
+{
+	return header()->entryCount;
+}
+
+bool VarSharedMemory::isStale() const
+{
+	return header()->stale.load( std::memory_order_acquire ) != 0;
+}
+
+int VarSharedMemory::findEntry( uint64_t nameHash, VarType type ) const
+{
+	auto entryIt = mEntryIndex.find( nameHash );
+	if( entryIt == mEntryIndex.end() || entries()[entryIt->second].type != static_cast<uint32_t>( type ) )
+		return -1;
+	return static_cast<int>( entryIt->second );
+}
+
+void VarSharedMemory::write( size_t index, const char* data )
+{
+	CI_ASSERT( mWriter );
+	Entry& entry = entries()[index];
+	char* value = values() + entry.offset;
+	if( std::memcmp( value, data, entry.size ) == 0 )
+		return;
+
+	const uint32_t sequence = entry.sequence.load( std::memory_order_relaxed );
+	entry.sequence.store( sequence + 1, std::memory_order_relaxed );
+	std::atomic_thread_fence( std::memory_order_release );
+	std::memcpy( value, data, entry.size );
+	entry.sequence.store( sequence + 2, std::memory_order_release );
+}
+
+bool VarSharedMemory::read( size_t index, uint32_t* sequence, std::vector<char>* out ) const
+{
+	const Entry& entry = entries()[index];
+	const uint32_t before = entry.sequence.load( std::memory_order_acquire );
+	if( before == *sequence || ( before & 1 ) )
+		return false;
+
+	out->resize( entry.size );
+	std::memcpy( out->data(), values() + entry.offset, entry.size );
+	std::atomic_thread_fence( std::memory_order_acquire );
+	if( entry.sequence.load( std::memory_order_relaxed ) != before )
+		return false; // written meanwhile, read again next time
+
+	*sequence = before;
+	return true;
+}
+
+#if defined( CINDER_MSW )
+
+std::unique_ptr<VarSharedMemory> VarSharedMemory::create( const std::string& name, const std::vector<Item>& items, int mode )
+{
+	CI_LOG_E( "POSIX shared memory is not supported on this platform" );
+	return nullptr;
+}
+
+std::unique_ptr<VarSharedMemory> VarSharedMemory::open( const std::string& name )
+{
+	CI_LOG_E( "POSIX shared memory is not supported on this platform" );
+	return nullptr;
+}
+
+VarSharedMemory::~VarSharedMemory()
+{
+}
+
+#else
+
+std::unique_ptr<VarSharedMemory> VarSharedMemory::create( const std::string& name, const std::vector<Item>& items, int mode )
+{
+	// readers of a previous object under this name open the new one
+	const int previous = ::shm_open( name.c_str(), O_RDWR, 0 );
+	if( previous >= 0 ) {
+		struct stat state;
+		if( ::fstat( previous, &state ) == 0 && size_t( state.st_size ) >= sizeof( Header ) ) {
+			if( void* data = ::mmap( nullptr, sizeof( Header ), PROT_READ | PROT_WRITE, MAP_SHARED, previous, 0 ); data != MAP_FAILED ) {
+				static_cast<Header*>( data )->stale.store( 1, std::memory_order_release );
+				::munmap( data, sizeof( Header ) );
+			}
+		}
+		::close( previous );
+		::shm_unlink( name.c_str() );
+	}
+
+	size_t valuesSize = 0;
+	for( const auto& item : items )
+		valuesSize = alignValue( valuesSize ) + item.size;
+	const size_t valuesOffset = alignValue( sizeof( Header ) + items.size() * sizeof( Entry ) );
+	const size_t size = valuesOffset + valuesSize;
+
+	const int fd = ::shm_open( name.c_str(), O_CREAT | O_EXCL | O_RDWR, static_cast<mode_t>( mode ) );
+	if( fd < 0 ) {
+		CI_LOG_E( "Failed to create the shared memory " + name + ". " + std::strerror( errno ) );
+		return nullptr;
+	}
+	// exactly the requested mode, shm_open() applies the umask
+	if( ::fchmod( fd, static_cast<mode_t>( mode ) ) != 0 ) {
+		CI_LOG_E( "Failed to set the permissions of the shared memory " + name + ". " + std::strerror( errno ) );
+		::close( fd );
+		::shm_unlink( name.c_str() );
+		return nullptr;
+	}
+	void* data = ::ftruncate( fd, size ) == 0 ? ::mmap( nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 ) : MAP_FAILED;
+	::close( fd );
+	if( data == MAP_FAILED ) {
+		CI_LOG_E( "Failed to map the shared memory " + name + ". " + std::strerror( errno ) );
+		::shm_unlink( name.c_str() );
+		return nullptr;
+	}
+
+	std::unique_ptr<VarSharedMemory> memory{ new VarSharedMemory };
+	memory->mName = name;
+	memory->mData = static_cast<char*>( data );
+	memory->mSize = size;
+	memory->mWriter = true;
+
+	// zero-filled by ftruncate
+	Header& header = *memory->header();
+	header.format = SHARED_MEMORY_FORMAT;
+	header.entryCount = static_cast<uint32_t>( items.size() );
+	header.size = size;
+
+	size_t offset = 0;
+	for( uint32_t i = 0; i < items.size(); ++i ) {
+		offset = alignValue( offset );
+		Entry& entry = memory->entries()[i];
+		entry.nameHash = items[i].nameHash;
+		entry.offset = static_cast<uint32_t>( offset );
+		entry.size = items[i].size;
+		entry.type = static_cast<uint32_t>( items[i].type );
+		// even and never 0, so that readers apply the initial value
+		entry.sequence.store( 2, std::memory_order_relaxed );
+		memory->mEntryIndex[entry.nameHash] = i;
+		offset += entry.size;
+	}
+	// last: readers ignore the object until then
+	std::atomic_thread_fence( std::memory_order_release );
+	std::memcpy( header.magic, SHARED_MEMORY_MAGIC, sizeof( SHARED_MEMORY_MAGIC ) );
+	return memory;
+}
+
+std::unique_ptr<VarSharedMemory> VarSharedMemory::open( const std::string& name )
+{
+	const int fd = ::shm_open( name.c_str(), O_RDONLY, 0 );
+	if( fd < 0 )
+		return nullptr;
+
+	struct stat state;
+	void* data = MAP_FAILED;
+	if( ::fstat( fd, &state ) == 0 && size_t( state.st_size ) >= sizeof( Header ) )
+		data = ::mmap( nullptr, state.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+	::close( fd );
+	if( data == MAP_FAILED )
+		return nullptr;
+
+	std::unique_ptr<VarSharedMemory> memory{ new VarSharedMemory };
+	memory->mName = name;
+	memory->mData = static_cast<char*>( data );
+	memory->mSize = state.st_size;
+
+	const Header& header = *memory->header();
+	if( std::memcmp( header.magic, SHARED_MEMORY_MAGIC, sizeof( SHARED_MEMORY_MAGIC ) ) != 0 )
+		return nullptr; // still being created
+	std::atomic_thread_fence( std::memory_order_acquire );
+	if( header.format != SHARED_MEMORY_FORMAT
+		|| header.size > memory->mSize	// can be rounded up to whole pages
+		|| alignValue( sizeof( Header ) + size_t( header.entryCount ) * sizeof( Entry ) ) > header.size ) {
+		CI_LOG_E( "Invalid shared memory " + name );
+		return nullptr;
+	}
+
+	const size_t valuesSize = header.size - ( memory->values() - memory->mData );
+	for( uint32_t i = 0; i < header.entryCount; ++i ) {
+		const Entry& entry = memory->entries()[i];
+		if( size_t( entry.offset ) + entry.size > valuesSize ) {
+			CI_LOG_E( "Invalid shared memory " + name );
+			return nullptr;
+		}
+		memory->mEntryIndex[entry.nameHash] = i;
+	}
+	return memory;
+}
+
+VarSharedMemory::~VarSharedMemory()
+{
+	if( ! mData )
+		return;
+
+	// unless already replaced by a newer object under the same name
+	if( mWriter && header()->stale.exchange( 1, std::memory_order_acq_rel ) == 0 )
+		::shm_unlink( mName.c_str() );
+	::munmap( mData, mSize );
+}
+
+#endif
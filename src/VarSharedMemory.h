@@ -0,0 +1,73 @@
+#pragma once
+
+#include "cinder/Cinder.h"
+
+#include "VarBinary.h"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cinder {
+
+	/**
+	 * A POSIX shared memory object holding the binary values of fixed-size vars, see JsonBag::publishSharedMemory().
+	 *
+	 * Layout: a header, one entry per var ("group.name" hash, type, offset, size and sequence counter), then
+	 * the values. The layout is fixed at creation: when the publisher's vars change, it marks the object
+	 * stale and creates a new one under the same name, which the readers open again.
+	 *
+	 * Each value is guarded by its sequence counter (a seqlock): odd while being written, so that readers
+	 * never apply a torn value and never block the writer.
+	 */
+	class VarSharedMemory : public ci::Noncopyable {
+	public:
+		struct Item {
+			uint64_t	nameHash;	// VarRegistry::hash( groupName, name )
+			VarType		type;
+			uint32_t	size;
+		};
+
+		//! Creates or replaces the object \a name, e.g. "/live_vars", with the permissions \a mode, e.g. 0600.
+		//! Returns null on failure.
+		static std::unique_ptr<VarSharedMemory> create( const std::string& name, const std::vector<Item>& items, int mode );
+		//! Maps the object \a name read-only. Returns null when it does not exist or is not valid.
+		static std::unique_ptr<VarSharedMemory> open( const std::string& name );
+		//! Unmaps the object. The creator also marks it stale and removes its name.
+		~VarSharedMemory();
+
+		bool isWriter() const { return mWriter; }
+		//! True once the writer replaced or removed the object.
+		bool isStale() const;
+
+		size_t getEntryCount() const;
+		//! Index of the entry of a var, -1 when it is not published.
+		int findEntry( uint64_t nameHash, VarType type ) const;
+
+		//! Writer only. Publishes \a data, of the entry's size, if it differs from the current value.
+		void write( size_t index, const char* data );
+		//! Copies the value of the entry to \a out when its sequence differs from \a *sequence, and updates
+		//! \a *sequence. Returns false when the value did not change, or is being written.
+		bool read( size_t index, uint32_t* sequence, std::vector<char>* out ) const;
+
+	private:
+		struct Header;
+		struct Entry;
+
+		VarSharedMemory() = default;
+
+		Header* header() const { return reinterpret_cast<Header*>( mData ); }
+		Entry* entries() const;
+		char* values() const;
+
+		std::string	mName;
+		char*		mData = nullptr;
+		size_t		mSize = 0;
+		bool		mWriter = false;
+		std::unordered_map<uint64_t, uint32_t>	mEntryIndex;	// by name hash
+	};
+
+} //namespace cinder
@@ -0,0 +1,234 @@
+#include "VarSocket.h"
+
+#include "cinder/Log.h"
+#include "cinder/Thread.h"
+
+#include <cerrno>
+#include <cstring>
+
+#if ! defined( CINDER_MSW )
+	#include <fcntl.h>
+	#include <poll.h>
+	#include <sys/socket.h>
+	#include <sys/stat.h>
+	#include <sys/un.h>
+	#include <unistd.h>
+#endif
+
+using namespace ci;
+
+// longest accepted request, a client sending more without a newline is disconnected
+static const size_t MAX_REQUEST_SIZE = 64 * 1024;
+
+#if defined( CINDER_MSW )
+
+std::unique_ptr<VarSocketServer> VarSocketServer::open( const fs::path& path, int mode )
+{
+	CI_LOG_E( "Unix domain sockets are not supported on this platform" );
+	return nullptr;
+}
+
+VarSocketServer::~VarSocketServer()
+{
+}
+
+void VarSocketServer::threadFn()
+{
+}
+
+void VarSocketServer::wake()
+{
+}
+
+#else
+
+std::unique_ptr<VarSocketServer> VarSocketServer::open( const fs::path& path, int mode )
+{
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	const std::string pathString = path.string();
+	if( pathString.size() >= sizeof( address.sun_path ) ) {
+		CI_LOG_E( "Socket path too long: " + pathString );
+		return nullptr;
+	}
+	std::memcpy( address.sun_path, pathString.c_str(), pathString.size() + 1 );
+
+	std::unique_ptr<VarSocketServer> server{ new VarSocketServer };
+	server->mListenSocket = ::socket( AF_UNIX, SOCK_STREAM, 0 );
+	if( server->mListenSocket < 0 || ::pipe( server->mWakePipe ) != 0 ) {
+		CI_LOG_E( "Failed to create the socket " + pathString + ". " + std::strerror( errno ) );
+		return nullptr;
+	}
+	::fcntl( server->mListenSocket, F_SETFD, FD_CLOEXEC );
+	::fcntl( server->mWakePipe[0], F_SETFL, O_NONBLOCK );
+	::fcntl( server->mWakePipe[1], F_SETFL, O_NONBLOCK );
+
+	// a socket left behind by a previous run, never any other file
+	struct stat state;
+	if( ::lstat( pathString.c_str(), &state ) == 0 ) {
+		if( ! S_ISSOCK( state.st_mode ) ) {
+			CI_LOG_E( "Failed to listen on " + pathString + ". The path exists and is not a socket" );
+			return nullptr;
+		}
+		::unlink( pathString.c_str() );
+	}
+	if( ::bind( server->mListenSocket, reinterpret_cast<const sockaddr*>( &address ), sizeof( address ) ) != 0 ) {
+		CI_LOG_E( "Failed to bind " + pathString + ". " + std::strerror( errno ) );
+		return nullptr;
+	}
+	// removed by the destructor from now on
+	server->mPath = path;
+	// before listen(): no client can connect while the file still has the permissions of the umask
+	if( ::chmod( pathString.c_str(), static_cast<mode_t>( mode ) ) != 0 ) {
+		CI_LOG_E( "Failed to set the permissions of " + pathString + ". " + std::strerror( errno ) );
+		return nullptr;
+	}
+	if( ::listen( server->mListenSocket, SOMAXCONN ) != 0 ) {
+		CI_LOG_E( "Failed to listen on " + pathString + ". " + std::strerror( errno ) );
+		return nullptr;
+	}
+
+	server->mThread = std::thread( &VarSocketServer::threadFn, server.get() );
+	return server;
+}
+
+VarSocketServer::~VarSocketServer()
+{
+	if( mThread.joinable() ) {
+		mStopping = true;
+		wake();
+		mThread.join();
+	}
+
+	for( const auto& client : mClients )
+		::close( client.second.socket );
+	if( mListenSocket >= 0 ) {
+		::close( mListenSocket );
+		if( ! mPath.empty() )
+			::unlink( mPath.string().c_str() );
+	}
+	for( const int fd : mWakePipe ) {
+		if( fd >= 0 )
+			::close( fd );
+	}
+}
+
+void VarSocketServer::wake()
+{
+	const char byte = 0;
+	// a full pipe already wakes the thread
+	( void )::write( mWakePipe[1], &byte, 1 );
+}
+
+void VarSocketServer::threadFn()
+{
+	ci::ThreadSetup threadSetup;
+	std::vector<pollfd> fds;
+	std::vector<uint64_t> fdClients;
+	char buffer[4096];
+
+	while( ! mStopping ) {
+		// move the queued replies to their clients
+		{
+			std::lock_guard<std::mutex> lock( mMutex );
+			for( auto& outgoing : mOutgoing ) {
+				auto clientIt = mClients.find( outgoing.first );
+				if( clientIt != mClients.end() )
+					clientIt->second.output.append( outgoing.second ).append( 1, '\n' );
+			}
+			mOutgoing.clear();
+		}
+
+		fds.assign( { { mWakePipe[0], POLLIN, 0 }, { mListenSocket, POLLIN, 0 } } );
+		fdClients.assign( 2, 0 );
+		for( const auto& client : mClients ) {
+			fds.push_back( { client.second.socket, short( POLLIN | ( client.second.output.empty() ? 0 : POLLOUT ) ), 0 } );
+			fdClients.push_back( client.first );
+		}
+
+		if( ::poll( fds.data(), fds.size(), -1 ) < 0 ) {
+			if( errno == EINTR )
+				continue;
+			CI_LOG_E( std::string( "Socket poll failed. " ) + std::strerror( errno ) );
+			break;
+		}
+
+		if( fds[0].revents & POLLIN ) {
+			while( ::read( mWakePipe[0], buffer, sizeof( buffer ) ) > 0 )
+				;
+		}
+
+		if( fds[1].revents & POLLIN ) {
+			const int socket = ::accept( mListenSocket, nullptr, nullptr );
+			if( socket >= 0 ) {
+				::fcntl( socket, F_SETFL, O_NONBLOCK );
+				::fcntl( socket, F_SETFD, FD_CLOEXEC );
+				mClients[mNextClient++] = Client{ socket, {}, {} };
+			}
+		}
+
+		std::vector<Request> requests;
+		for( size_t i = 2; i < fds.size(); ++i ) {
+			auto clientIt = mClients.find( fdClients[i] );
+			Client& client = clientIt->second;
+			bool closed = ( fds[i].revents & ( POLLERR | POLLNVAL ) ) != 0;
+
+			if( ! closed && ( fds[i].revents & ( POLLIN | POLLHUP ) ) ) {
+				const auto size = ::recv( client.socket, buffer, sizeof( buffer ), 0 );
+				if( size > 0 ) {
+					client.input.append( buffer, size );
+					size_t begin = 0;
+					for( size_t end; ( end = client.input.find( '\n', begin ) ) != std::string::npos; begin = end + 1 ) {
+						std::string line = client.input.substr( begin, end - begin );
+						if( ! line.empty() && line.back() == '\r' )
+							line.pop_back();
+						if( ! line.empty() )
+							requests.push_back( { clientIt->first, std::move( line ), false } );
+					}
+					client.input.erase( 0, begin );
+					closed = client.input.size() > MAX_REQUEST_SIZE;
+				}
+				else
+					closed = size == 0 || ( errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR );
+			}
+
+			if( ! closed && ( fds[i].revents & POLLOUT ) ) {
+				const auto size = ::send( client.socket, client.output.data(), client.output.size(), MSG_NOSIGNAL );
+				if( size > 0 )
+					client.output.erase( 0, size );
+				else
+					closed = size < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR;
+			}
+
+			if( closed ) {
+				::close( client.socket );
+				mClients.erase( clientIt );
+				requests.push_back( { fdClients[i], {}, true } );
+			}
+		}
+
+		if( ! requests.empty() ) {
+			std::lock_guard<std::mutex> lock( mMutex );
+			mRequests.insert( mRequests.end(), std::make_move_iterator( requests.begin() ), std::make_move_iterator( requests.end() ) );
+		}
+	}
+}
+
+#endif
+
+std::vector<VarSocketServer::Request> VarSocketServer::takeRequests()
+{
+	std::vector<Request> requests;
+	std::lock_guard<std::mutex> lock( mMutex );
+	std::swap( requests, mRequests );
+	return requests;
+}
+
+void VarSocketServer::send( uint64_t client, const std::string& line )
+{
+	{
+		std::lock_guard<std::mutex> lock( mMutex );
+		mOutgoing.emplace_back( client, line );
+	}
+	wake();
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "cinder/Cinder.h"
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cinder {
+
+	/**
+	 * A local Unix domain socket receiving one request per line, see JsonBag::listen().
+	 *
+	 *   set group.name <value>     value as written in the var files, e.g. 0.5 or { "x" : "1", "y" : "2" }
+	 *   get group.name             replied with "group.name <value>"
+	 *   subscribe group.name       replied with "group.name <value>" now and on each change of the var
+	 *   unsubscribe group.name
+	 *
+	 * Failed requests are replied with "error <message>". The sockets are served by a background thread,
+	 * the requests are handled by the owner, e.g. from the main thread.
+	 */
+	class VarSocketServer : public ci::Noncopyable {
+	public:
+		struct Request {
+			uint64_t	client;
+			std::string	line;		// without the newline
+			bool		closed;		// the client disconnected, line is empty
+		};
+
+		//! Returns null when \a path cannot be bound, e.g. on Windows. \a mode is given to the socket file, e.g. 0600.
+		static std::unique_ptr<VarSocketServer> open( const fs::path& path, int mode );
+		~VarSocketServer();
+
+		//! Requests received since the last call, in order. Thread-safe.
+		std::vector<Request> takeRequests();
+		//! Queues \a line, without newline, for \a client. Thread-safe, ignored once the client is gone.
+		void send( uint64_t client, const std::string& line );
+
+		const fs::path& getPath() const { return mPath; }
+
+	private:
+		VarSocketServer() = default;
+
+		struct Client {
+			int			socket;
+			std::string	input, output;
+		};
+
+		void threadFn();
+		void wake();
+
+		fs::path				mPath;
+		int						mListenSocket = -1;
+		int						mWakePipe[2] = { -1, -1 };
+		std::thread				mThread;
+		std::atomic<bool>		mStopping{ false };
+
+		std::mutex				mMutex;
+		std::vector<Request>	mRequests;
+		std::vector<std::pair<uint64_t, std::string>>	mOutgoing;
+
+		// only touched by the server thread
+		std::map<uint64_t, Client>	mClients;
+		uint64_t				mNextClient = 1;
+	};
+
+} //namespace cinder
@@ -0,0 +1,69 @@
+#pragma once
+
+#include "cinder/Cinder.h"
+
+#include <cstddef>
+
+namespace cinder {
+
+	/**
+	 * Counters and timings of a single load or save, passed to the JsonBag event hook.
+	 *
+	 * Durations are in seconds. The fields that do not apply to the event type stay at 0.
+	 */
+	struct VarEvent {
+		enum class Type { Load, Save };
+
+		Type		type = Type::Load;
+		fs::path	path;
+		bool		success = false;	// false when the file was missing, invalid or could not be written
+		size_t		bytes = 0;			// read or written
+
+		// load
+		double		readTime = 0.0, parseTime = 0.0, applyTime = 0.0, callbackTime = 0.0;
+		size_t		varsChanged = 0, varsDefaulted = 0;
+		//! From the modification time of the file to the end of the update callbacks, for the reloads of a
+		//! modified file by JsonBag::scheduleReload(). Negative for the other loads, e.g. the first one.
+		double		latency = -1.0;
+
+		// save
+		double		captureTime = 0.0, writeTime = 0.0;
+	};
+
+	//! Totals of the events of a JsonBag since it was created or its stats were reset.
+	struct VarStats {
+		size_t		loads = 0, failedLoads = 0, skippedLoads = 0, saves = 0, failedSaves = 0;
+		size_t		bytesRead = 0, bytesWritten = 0, varsChanged = 0, varsDefaulted = 0;
+		double		readTime = 0.0, parseTime = 0.0, applyTime = 0.0, callbackTime = 0.0;
+		double		captureTime = 0.0, writeTime = 0.0;
+		double		maxLatency = 0.0;
+		VarEvent	lastLoad, lastSave;
+
+		void add( const VarEvent& event )
+		{
+			if( event.type == VarEvent::Type::Load ) {
+				++loads;
+				failedLoads += event.success ? 0 : 1;
+				bytesRead += event.bytes;
+				varsChanged += event.varsChanged;
+				varsDefaulted += event.varsDefaulted;
+				readTime += event.readTime;
+				parseTime += event.parseTime;
+				applyTime += event.applyTime;
+				callbackTime += event.callbackTime;
+				if( event.latency > maxLatency )
+					maxLatency = event.latency;
+				lastLoad = event;
+			}
+			else {
+				++saves;
+				failedSaves += event.success ? 0 : 1;
+				bytesWritten += event.bytes;
+				captureTime += event.captureTime;
+				writeTime += event.writeTime;
+				lastSave = event;
+			}
+		}
+	};
+
+} //namespace cinder
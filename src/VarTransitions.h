@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace cinder {
+
+	class VarBase;
+
+	//! Easing curve over [0, 1], e.g. ci::easeInOutQuad. Null means linear.
+	typedef float (*VarEaseFn)( float );
+
+	/**
+	 * In-flight interpolations of float-based var values (float, vecs, Color) toward a new value.
+	 *
+	 * Components are stored as flat arrays so that step() evaluates every transition in a single
+	 * vectorizable loop, then copies the results into the var values. Not thread-safe: JsonBag
+	 * guards it with its items mutex.
+	 */
+	class VarTransitions {
+	public:
+		//! The handle of a var without transition.
+		static constexpr uint32_t NONE = ~uint32_t( 0 );
+
+		//! Replaces the transition whose handle is \a *handle, if any. \a target is where the var stores its
+		//! \a count floats. \a *handle is kept up to date until the transition ends, then set to NONE.
+		void start( VarBase* var, uint32_t* handle, float* target, size_t count, const float* end, float duration, VarEaseFn easing )
+		{
+			cancel( handle );
+
+			Transition transition;
+			transition.var = var;
+			transition.handle = handle;
+			transition.target = target;
+			transition.first = static_cast<uint32_t>( mStart.size() );
+			transition.count = static_cast<uint32_t>( count );
+			transition.time = 0.0f;
+			transition.invDuration = 1.0f / duration;
+			transition.easing = easing;
+			*handle = static_cast<uint32_t>( mTransitions.size() );
+			mTransitions.push_back( transition );
+			++mActiveCount;
+
+			for( size_t i = 0; i < count; ++i ) {
+				float endValue;
+				std::memcpy( &endValue, end + i, sizeof( float ) );
+				mStart.push_back( target[i] );
+				mDelta.push_back( endValue - target[i] );
+			}
+			mWeights.resize( mStart.size() );
+			mValues.resize( mStart.size() );
+		}
+
+		//! Constant time: the transition is only marked, and dropped by the next step().
+		void cancel( uint32_t* handle )
+		{
+			if( *handle == NONE )
+				return;
+
+			Transition& transition = mTransitions[*handle];
+			transition.time = -1.0f;
+			transition.handle = nullptr;
+			*handle = NONE;
+			--mActiveCount;
+			mHasCanceled = true;
+		}
+
+		//! Advances all transitions by \a elapsed seconds and writes the new values. Calls \a changed( VarBase* )
+		//! for each var whose value changed.
+		template<typename Changed>
+		void step( float elapsed, Changed changed )
+		{
+			if( mTransitions.empty() )
+				return;
+
+			bool finished = false;
+			for( auto& transition : mTransitions ) {
+				if( transition.time < 0.0f )
+					continue;
+				transition.time += elapsed;
+				float progress = std::min( transition.time * transition.invDuration, 1.0f );
+				finished |= progress >= 1.0f;
+				if( transition.easing && progress < 1.0f )
+					progress = transition.easing( progress );
+				std::fill_n( mWeights.data() + transition.first, transition.count, progress );
+			}
+
+			const float* start = mStart.data();
+			const float* delta = mDelta.data();
+			const float* weights = mWeights.data();
+			float* values = mValues.data();
+			const size_t size = mValues.size();
+			for( size_t i = 0; i < size; ++i )
+				values[i] = start[i] + delta[i] * weights[i];
+
+			for( const auto& transition : mTransitions ) {
+				const size_t bytes = transition.count * sizeof( float );
+				if( transition.time >= 0.0f && std::memcmp( transition.target, values + transition.first, bytes ) != 0 ) {
+					std::memcpy( transition.target, values + transition.first, bytes );
+					changed( transition.var );
+				}
+			}
+
+			// once per step, however many transitions were canceled since the last one
+			if( finished || mHasCanceled )
+				compact();
+		}
+
+		//! Number of transitions in flight.
+		bool empty() const { return mActiveCount == 0; }
+		size_t size() const { return mActiveCount; }
+
+	private:
+		struct Transition {
+			VarBase*	var;
+			uint32_t*	handle;				// null once canceled
+			float*		target;
+			uint32_t	first, count;
+			float		time, invDuration;	// time < 0: canceled
+			VarEaseFn	easing;
+		};
+
+		// drops the finished and canceled transitions
+		void compact()
+		{
+			size_t kept = 0, keptComponents = 0;
+			for( auto transition : mTransitions ) {
+				if( transition.time < 0.0f )
+					continue;
+				if( transition.time * transition.invDuration >= 1.0f ) {
+					*transition.handle = NONE;
+					continue;
+				}
+				std::copy_n( mStart.begin() + transition.first, transition.count, mStart.begin() + keptComponents );
+				std::copy_n( mDelta.begin() + transition.first, transition.count, mDelta.begin() + keptComponents );
+				transition.first = static_cast<uint32_t>( keptComponents );
+				keptComponents += transition.count;
+				*transition.handle = static_cast<uint32_t>( kept );
+				mTransitions[kept++] = transition;
+			}
+			mTransitions.resize( kept );
+			mStart.resize( keptComponents );
+			mDelta.resize( keptComponents );
+			mWeights.resize( keptComponents );
+			mValues.resize( keptComponents );
+			mActiveCount = kept;
+			mHasCanceled = false;
+		}
+
+		std::vector<Transition>	mTransitions;
+		// one entry per float component
+		std::vector<float>		mStart, mDelta, mWeights, mValues;
+		size_t					mActiveCount = 0;
+		bool					mHasCanceled = false;
+	};
+
+} //namespace cinder